@@ -0,0 +1,396 @@
+#include "action_log.hpp"
+
+#include <cstring>
+
+#include "checkpoint.hpp"
+#include "map_manager.hpp"
+#include "plant.hpp"
+#include "tick_engine.hpp"
+#include "world.hpp"
+
+/**
+ * Fixed-size start of every action log, describing the world it was recorded on
+ */
+struct ActionLogHeader {
+    char magic[8];
+    uint32_t version;
+    int32_t rows;
+    int32_t columns;
+    int64_t startTick;
+    uint64_t seed;
+    uint64_t elementCount;
+};
+
+static const char ACTION_LOG_MAGIC[8] = {'E', 'C', 'O', 'S', 'I', 'M', 'A', 'L'};
+
+/**
+ * Fixed-size start of every keyframe index, followed by the array of keyframes in tick order
+ */
+struct KeyframeIndexHeader {
+    char magic[8];
+    uint32_t version;
+};
+
+static const char KEYFRAME_INDEX_MAGIC[8] = {'E', 'C', 'O', 'S', 'I', 'M', 'K', 'I'};
+
+// A type byte followed by at most three 32-bit varints
+static const size_t MAX_ENTRY_BYTES = 1 + 3 * 5;
+
+bool ActionLog::recording = false;
+std::vector<uint8_t> ActionLog::gatheredEntries;
+std::unique_ptr<BinaryWriter> ActionLog::writer;
+std::string ActionLog::recordingPath;
+long ActionLog::keyframeInterval = 0;
+long ActionLog::recordingStartTick = 0;
+std::vector<ActionLog::Keyframe> ActionLog::keyframes;
+bool ActionLog::keyframesWritten = true;
+std::unique_ptr<BinaryReader> ActionLog::replayReader;
+std::string ActionLog::replayPath;
+std::vector<ActionLog::Keyframe> ActionLog::replayKeyframes;
+std::vector<uint8_t> ActionLog::replayBuffer;
+size_t ActionLog::replayPosition = 0;
+size_t ActionLog::replayEnd = 0;
+
+/**
+ * Appends a value as a little-endian base-128 varint
+ * @param value value to append
+ * @param bytes buffer to append to
+ */
+static void appendVarint(uint32_t value, std::vector<uint8_t> &bytes) {
+    while (value >= 0x80) {
+        bytes.push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back((uint8_t) value);
+}
+
+/**
+ * Describes the current world in the form stored at the start of a log
+ * @return header of a log starting from the current world
+ */
+static ActionLogHeader currentWorldHeader() {
+    ActionLogHeader header{};
+    memcpy(header.magic, ACTION_LOG_MAGIC, sizeof(header.magic));
+    header.version = ActionLog::FORMAT_VERSION;
+    header.rows = MapManager::mapRows();
+    header.columns = MapManager::mapColumns();
+    header.startTick = TickEngine::getTickCount();
+    header.seed = TickEngine::getSeed();
+    header.elementCount = MapManager::entities().aliveCount();
+    return header;
+}
+
+bool ActionLog::startRecording(const std::string &filePath, long keyframeInterval) {
+    stopRecording();
+    writer = std::make_unique<BinaryWriter>(filePath);
+    if (!writer->good()) {
+        writer.reset();
+        return false;
+    }
+    writer->write(currentWorldHeader());
+    for (ActionLogData::WorkerEntries &worker: World::current().actionLog.workerEntries) {
+        worker.bytes.clear();
+    }
+    gatheredEntries.clear();
+    recordingPath = filePath;
+    ActionLog::keyframeInterval = keyframeInterval;
+    recordingStartTick = TickEngine::getTickCount();
+    keyframes.clear();
+    keyframesWritten = true;
+    recording = true;
+    return true;
+}
+
+void ActionLog::collectWorkerEntries() {
+    if (!recording) {
+        return;
+    }
+    for (ActionLogData::WorkerEntries &worker: World::current().actionLog.workerEntries) {
+        gatheredEntries.insert(gatheredEntries.end(), worker.bytes.begin(), worker.bytes.end());
+        worker.bytes.clear();
+    }
+}
+
+void ActionLog::endPhase() {
+    if (recording) {
+        collectWorkerEntries();
+        gatheredEntries.push_back(PHASE_END_ACTION);
+    }
+}
+
+void ActionLog::endTick() {
+    if (!recording) {
+        return;
+    }
+    collectWorkerEntries();
+    gatheredEntries.push_back(TICK_END_ACTION);
+    // A keyframe is indexed at the end of the written log, so everything gathered is written out first
+    long recordedTicks = TickEngine::getTickCount() - recordingStartTick;
+    bool keyframeDue = keyframeInterval > 0 && recordedTicks % keyframeInterval == 0;
+    if (gatheredEntries.size() >= WRITE_BLOCK_SIZE || keyframeDue) {
+        writer->writeBytes(gatheredEntries.data(), gatheredEntries.size());
+        gatheredEntries.clear();
+    }
+    if (keyframeDue) {
+        writeKeyframe();
+    }
+}
+
+void ActionLog::writeKeyframe() {
+    long tick = TickEngine::getTickCount();
+    if (Checkpoint::save(keyframePath(recordingPath, tick))) {
+        keyframes.push_back({tick, (uint64_t) writer->position()});
+    } else {
+        keyframesWritten = false;
+    }
+}
+
+std::string ActionLog::keyframePath(const std::string &filePath, long tick) {
+    return filePath + "." + std::to_string(tick) + ".ckpt";
+}
+
+void ActionLog::setWorkerCount(int workerCount) {
+    // Entries of workers that are about to go away are gathered first
+    collectWorkerEntries();
+    World::current().actionLog.workerEntries.resize(workerCount);
+}
+
+bool ActionLog::stopRecording() {
+    if (!recording) {
+        return true;
+    }
+    // Entries of an unfinished tick are dropped, a log only ever holds whole ticks
+    for (ActionLogData::WorkerEntries &worker: World::current().actionLog.workerEntries) {
+        worker.bytes.clear();
+    }
+    size_t lastTickEnd = gatheredEntries.size();
+    while (lastTickEnd > 0 && gatheredEntries[lastTickEnd - 1] != TICK_END_ACTION) {
+        lastTickEnd--;
+    }
+    writer->writeBytes(gatheredEntries.data(), lastTickEnd);
+    gatheredEntries.clear();
+    recording = false;
+
+    bool written = writer->good() && keyframesWritten;
+    writer.reset();
+
+    // The index is always rewritten so an index left by an earlier recording never refers to this log
+    BinaryWriter indexWriter(recordingPath + ".index");
+    KeyframeIndexHeader indexHeader{};
+    memcpy(indexHeader.magic, KEYFRAME_INDEX_MAGIC, sizeof(indexHeader.magic));
+    indexHeader.version = FORMAT_VERSION;
+    indexWriter.write(indexHeader);
+    indexWriter.writeArray(keyframes);
+    return written && indexWriter.good();
+}
+
+void ActionLog::appendEntry(ActionType type, uint32_t value) {
+    std::vector<uint8_t> &bytes = World::current().actionLog.workerEntries[ThreadPool::workerIndex()].bytes;
+    bytes.push_back(type);
+    appendVarint(value, bytes);
+}
+
+void ActionLog::appendEntry(ActionType type, uint32_t value, const Point &location) {
+    std::vector<uint8_t> &bytes = World::current().actionLog.workerEntries[ThreadPool::workerIndex()].bytes;
+    bytes.push_back(type);
+    appendVarint(value, bytes);
+    appendVarint((uint32_t) location.first, bytes);
+    appendVarint((uint32_t) location.second, bytes);
+}
+
+bool ActionLog::openReplay(const std::string &filePath) {
+    replayReader = std::make_unique<BinaryReader>(filePath);
+    ActionLogHeader header{};
+    ActionLogHeader worldHeader = currentWorldHeader();
+    if (!replayReader->isOpen() || !replayReader->read(header) ||
+        memcmp(header.magic, ACTION_LOG_MAGIC, sizeof(header.magic)) != 0 || header.version != FORMAT_VERSION ||
+        header.rows != worldHeader.rows || header.columns != worldHeader.columns ||
+        header.startTick != worldHeader.startTick || header.elementCount != worldHeader.elementCount) {
+        replayReader.reset();
+        return false;
+    }
+
+    if (!readKeyframeIndex(filePath)) {
+        replayReader.reset();
+        return false;
+    }
+
+    TickEngine::setSeed(header.seed);
+    replayPath = filePath;
+    replayBuffer.resize(WRITE_BLOCK_SIZE);
+    replayPosition = 0;
+    replayEnd = 0;
+    refillReplayBuffer();
+    return true;
+}
+
+bool ActionLog::readKeyframeIndex(const std::string &filePath) {
+    replayKeyframes.clear();
+    BinaryReader indexReader(filePath + ".index");
+    if (!indexReader.isOpen()) {
+        return true;
+    }
+
+    KeyframeIndexHeader indexHeader{};
+    if (!indexReader.read(indexHeader) ||
+        memcmp(indexHeader.magic, KEYFRAME_INDEX_MAGIC, sizeof(indexHeader.magic)) != 0 ||
+        indexHeader.version != FORMAT_VERSION || !indexReader.readArray(replayKeyframes)) {
+        return false;
+    }
+    // Keyframes follow the start of the log in tick order and point into it
+    long previousTick = TickEngine::getTickCount();
+    for (const Keyframe &keyframe: replayKeyframes) {
+        if (keyframe.tick <= previousTick || keyframe.offset < sizeof(ActionLogHeader) ||
+            keyframe.offset > replayReader->size()) {
+            replayKeyframes.clear();
+            return false;
+        }
+        previousTick = keyframe.tick;
+    }
+    return true;
+}
+
+bool ActionLog::jumpToKeyframe(const Keyframe &keyframe) {
+    // Restoring sizes the per-worker buffers for a single worker, the replay keeps its thread count
+    int threadCount = TickEngine::getThreadCount();
+    if (!Checkpoint::restore(keyframePath(replayPath, keyframe.tick)) || TickEngine::getTickCount() != keyframe.tick ||
+        !replayReader->seek(keyframe.offset)) {
+        return false;
+    }
+    TickEngine::setThreadCount(threadCount);
+    replayPosition = 0;
+    replayEnd = 0;
+    refillReplayBuffer();
+    return true;
+}
+
+bool ActionLog::replayTo(long tick) {
+    if (!replayReader) {
+        return false;
+    }
+
+    // Restoring the last keyframe at or before the tick pays off whenever it lies ahead of the world or the world
+    // is already past the tick
+    const Keyframe *startKeyframe = nullptr;
+    for (const Keyframe &keyframe: replayKeyframes) {
+        if (keyframe.tick <= tick) {
+            startKeyframe = &keyframe;
+        }
+    }
+    long currentTick = TickEngine::getTickCount();
+    if (tick < currentTick && !startKeyframe) {
+        // Without a keyframe to restore the log can only move forwards
+        return false;
+    }
+    if (startKeyframe && (startKeyframe->tick > currentTick || tick < currentTick) &&
+        !jumpToKeyframe(*startKeyframe)) {
+        return false;
+    }
+
+    while (TickEngine::getTickCount() < tick && !replayFinished()) {
+        if (!replayTick()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ActionLog::replayTick() {
+    // Regrowth of the tick is applied from the log, due events are only dropped so that the schedule stays the
+    // same as in the recorded run
+    World &world = World::current();
+    world.events.takeDue(world.tickCount, world.dueEvents);
+
+    while (true) {
+        if (replayEnd - replayPosition < MAX_ENTRY_BYTES) {
+            refillReplayBuffer();
+        }
+        if (replayPosition == replayEnd) {
+            return false;
+        }
+
+        auto type = (ActionType) replayBuffer[replayPosition++];
+        uint32_t value;
+        uint32_t x = 0;
+        uint32_t y = 0;
+        switch (type) {
+            case MOVE_ACTION:
+            case EAT_ACTION:
+            case BIRTH_ACTION: {
+                if (!readVarint(value) || !readVarint(x) || !readVarint(y)) {
+                    return false;
+                }
+                Point location((int) x, (int) y);
+                if (x > INT32_MAX || y > INT32_MAX || !MapManager::floraFauna().inBounds(location)) {
+                    return false;
+                }
+                if (type == BIRTH_ACTION) {
+                    if (value >= MapManager::species().size() ||
+                        MapManager::species()[(SpeciesIndex) value].speciesType == SpeciesType::PLANT ||
+                        !MapManager::queueBirth((SpeciesIndex) value, location)) {
+                        return false;
+                    }
+                    break;
+                }
+                auto id = (EntityId) value;
+                if (value > INT32_MAX || !MapManager::nextEntities().isAlive(id) ||
+                    !(type == MOVE_ACTION ? MapManager::moveElement(id, location)
+                                          : MapManager::eatElement(id, location))) {
+                    return false;
+                }
+                break;
+            }
+            case KILL_ACTION:
+            case REGROW_ACTION: {
+                if (!readVarint(value) || value > INT32_MAX) {
+                    return false;
+                }
+                auto id = (EntityId) value;
+                if (!MapManager::nextEntities().isAlive(id) ||
+                    (MapManager::speciesOf(id).speciesType == SpeciesType::PLANT) != (type == REGROW_ACTION)) {
+                    return false;
+                }
+                if (type == KILL_ACTION) {
+                    MapManager::killElement(id);
+                } else {
+                    Plant::regrow(id);
+                }
+                break;
+            }
+            case PHASE_END_ACTION:
+                MapManager::swapBuffers();
+                break;
+            case TICK_END_ACTION:
+                TickEngine::setTickCount(TickEngine::getTickCount() + 1);
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+bool ActionLog::readVarint(uint32_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (replayPosition == replayEnd) {
+            return false;
+        }
+        uint8_t byte = replayBuffer[replayPosition++];
+        if (shift == 28 && byte > 0x0f) {
+            return false;
+        }
+        value |= (uint32_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ActionLog::refillReplayBuffer() {
+    size_t unreadBytes = replayEnd - replayPosition;
+    memmove(replayBuffer.data(), replayBuffer.data() + replayPosition, unreadBytes);
+    replayPosition = 0;
+    replayEnd = unreadBytes;
+    replayEnd += replayReader->readAvailable(replayBuffer.data() + replayEnd, replayBuffer.size() - replayEnd);
+}
@@ -0,0 +1,230 @@
+#ifndef ECOSIM_ACTION_LOG_HPP
+#define ECOSIM_ACTION_LOG_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "binary_io.hpp"
+#include "entity_store.hpp"
+#include "species_table.hpp"
+#include "thread_pool.hpp"
+
+/**
+ * Kinds of entries in an action log
+ */
+enum ActionType : uint8_t {
+    MOVE_ACTION = 1, EAT_ACTION, KILL_ACTION, BIRTH_ACTION, REGROW_ACTION, PHASE_END_ACTION, TICK_END_ACTION
+};
+
+/**
+ * Entries of one world recorded by its pool workers that were not yet gathered into the log. Every world keeps its
+ * own, so resizing them for a world's thread count never touches a world running on another thread
+ */
+struct ActionLogData {
+    struct alignas(64) WorkerEntries {
+        std::vector<uint8_t> bytes;
+    };
+
+    std::vector<WorkerEntries> workerEntries = std::vector<WorkerEntries>(1);
+};
+
+/**
+ * Records every state change the simulation makes so a run can be replayed without running it again. Entries are
+ * written by the MapManager actions themselves: moves, eats, starvation deaths and births of the animal phases, and
+ * regrowth of the plant phase, followed by a marker at the end of every phase and tick. Each entry is a type byte
+ * followed by its ids, species index and coordinates as little-endian base-128 varints, so most take four to six
+ * bytes.
+ *
+ * Replaying applies the entries through the same MapManager actions and commits the phases with swapBuffers, so
+ * no species logic, random draws or neighbor queries are involved and the replayed world is identical to the
+ * recorded one, down to entity ids, energy levels and scheduled regrowth. The log starts from the world it was
+ * recorded on, which has to be loaded before replaying it.
+ *
+ * Workers append to their own entry buffers, which are gathered in worker order between parallel passes. Workers of
+ * one pass touch cells that are too far apart to affect each other, so the gathered order replays correctly.
+ *
+ * Every few ticks the recording also saves a checkpoint of the world as a keyframe next to the log, and an index
+ * maps every keyframe's tick to the log offset its tick starts at. Seeking restores the last keyframe at or before
+ * the target and only replays the ticks after it, so reaching any tick of a long log costs one restore and at most
+ * one keyframe interval of replay, in either direction
+ */
+class ActionLog {
+public:
+    /**
+     * Starts recording the current world
+     * @param filePath filepath of the log, keyframes are written to the same path followed by their tick and the
+     * keyframe index to the same path followed by .index
+     * @param keyframeInterval ticks between keyframes, no keyframes are written when 0
+     * @return false if the file could not be opened
+     */
+    static bool startRecording(const std::string &filePath, long keyframeInterval = DEFAULT_KEYFRAME_INTERVAL);
+
+    static bool isRecording() { return recording; }
+
+    static void recordMove(EntityId id, const Point &location) {
+        if (recording) {
+            appendEntry(MOVE_ACTION, (uint32_t) id, location);
+        }
+    }
+
+    static void recordEat(EntityId eaterId, const Point &location) {
+        if (recording) {
+            appendEntry(EAT_ACTION, (uint32_t) eaterId, location);
+        }
+    }
+
+    static void recordKill(EntityId id) {
+        if (recording) {
+            appendEntry(KILL_ACTION, (uint32_t) id);
+        }
+    }
+
+    static void recordBirth(SpeciesIndex speciesIndex, const Point &location) {
+        if (recording) {
+            appendEntry(BIRTH_ACTION, speciesIndex, location);
+        }
+    }
+
+    static void recordRegrow(EntityId id) {
+        if (recording) {
+            appendEntry(REGROW_ACTION, (uint32_t) id);
+        }
+    }
+
+    /**
+     * Gathers the entries of every worker after a parallel pass, before the next pass may touch the same cells
+     */
+    static void collectWorkerEntries();
+
+    /**
+     * Marks the end of a phase, called when the phase is committed
+     */
+    static void endPhase();
+
+    /**
+     * Marks the end of a tick and writes the log out once enough entries have been gathered. Saves a keyframe when
+     * one is due
+     */
+    static void endTick();
+
+    /**
+     * Sets the number of pool workers of the current world that may record entries concurrently
+     * @param workerCount number of workers
+     */
+    static void setWorkerCount(int workerCount);
+
+    /**
+     * Writes the remaining entries and the keyframe index and closes the log
+     * @return false if any part of the log, a keyframe or the index could not be written
+     */
+    static bool stopRecording();
+
+    /**
+     * Opens a log for replay on the current world, which has to be the world the log was recorded on. Adopts the
+     * seed of the recorded run so the simulation can continue from any replayed tick exactly as it did when recorded.
+     * The keyframe index is read along with the log when there is one
+     * @param filePath filepath of the log
+     * @return false if the log could not be read, was recorded on a different world or has a corrupt index
+     */
+    static bool openReplay(const std::string &filePath);
+
+    /**
+     * Applies logged ticks until the tick count reaches the given tick or the log ends, starting from the last
+     * keyframe at or before the tick when that skips ticks. Seeking backwards past every keyframe requires loading
+     * the world and opening the log again
+     * @param tick tick to stop at
+     * @return false if the log or a keyframe is corrupt or does not match the world, or if the tick lies before the
+     * world's tick and no keyframe, in which case the world is left untouched
+     */
+    static bool replayTo(long tick);
+
+    /**
+     * Checks whether every tick of the open log has been replayed
+     * @return true if the log has no more ticks
+     */
+    static bool replayFinished() { return replayReader && replayPosition == replayEnd && replayReader->atEnd(); }
+
+    static void closeReplay() { replayReader.reset(); }
+
+    /**
+     * Returns the filepath of a log's keyframe
+     * @param filePath filepath of the log
+     * @param tick tick the keyframe was saved at
+     * @return filepath of the keyframe checkpoint
+     */
+    static std::string keyframePath(const std::string &filePath, long tick);
+
+    static const uint32_t FORMAT_VERSION = 1;
+    // Entries are gathered in memory until this many bytes can be written at once
+    static const size_t WRITE_BLOCK_SIZE = 1 << 20;
+    static const long DEFAULT_KEYFRAME_INTERVAL = 1000;
+
+private:
+    /**
+     * Tick of a keyframe and the offset in the log at which the entries of that tick start
+     */
+    struct Keyframe {
+        int64_t tick;
+        uint64_t offset;
+    };
+
+    static void appendEntry(ActionType type, uint32_t value);
+
+    static void appendEntry(ActionType type, uint32_t value, const Point &location);
+
+    /**
+     * Applies the entries of one tick
+     * @return false if the log is corrupt, ends within the tick or does not match the world
+     */
+    static bool replayTick();
+
+    /**
+     * Saves a keyframe of the current world and indexes it at the current end of the log
+     */
+    static void writeKeyframe();
+
+    /**
+     * Reads the keyframe index of the log being opened for replay, if it has one
+     * @param filePath filepath of the log
+     * @return false if the index is corrupt
+     */
+    static bool readKeyframeIndex(const std::string &filePath);
+
+    /**
+     * Restores a keyframe and continues the replay from the start of its tick
+     * @return false if the keyframe could not be restored
+     */
+    static bool jumpToKeyframe(const Keyframe &keyframe);
+
+    /**
+     * Reads a varint of the entry being replayed
+     * @param value decoded value
+     * @return false if the log ends within the varint or it does not fit 32 bits
+     */
+    static bool readVarint(uint32_t &value);
+
+    /**
+     * Moves unread bytes to the front of the replay buffer and fills the rest from the file
+     */
+    static void refillReplayBuffer();
+
+    static bool recording;
+    static std::vector<uint8_t> gatheredEntries;
+    static std::unique_ptr<BinaryWriter> writer;
+    static std::string recordingPath;
+    static long keyframeInterval;
+    static long recordingStartTick;
+    static std::vector<Keyframe> keyframes;
+    static bool keyframesWritten;
+
+    static std::unique_ptr<BinaryReader> replayReader;
+    static std::string replayPath;
+    static std::vector<Keyframe> replayKeyframes;
+    static std::vector<uint8_t> replayBuffer;
+    static size_t replayPosition;
+    static size_t replayEnd;
+};
+
+#endif //ECOSIM_ACTION_LOG_HPP
@@ -0,0 +1,280 @@
+//
+// EcoSimBench - Throughput benchmark on generated worlds
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+#include <sys/resource.h>
+
+#include "sim_utilities.hpp"
+#include "map_manager.hpp"
+#include "tick_engine.hpp"
+#include "species_table.hpp"
+#include "counter_rng.hpp"
+
+using namespace std;
+
+/**
+ * Benchmark settings. Densities are the fraction of map cells given to each species type, shared evenly between
+ * the species of that type
+ */
+struct BenchOptions {
+    vector<int> sizes = {100, 1000};
+    string speciesFilePath = "default_input/species.txt";
+    string csvFilePath = "bench_results.csv";
+    double terrainFraction = 0.1;
+    double plantDensity = 0.2;
+    double herbivoreDensity = 0.05;
+    double omnivoreDensity = 0.02;
+    int ticks = 20;
+    int threadCount = 1;
+    uint64_t seed = 1;
+};
+
+/**
+ * Time spent in each part of a benchmark run
+ */
+struct BenchResult {
+    int size = 0;
+    size_t elementCount = 0;
+    double loadSeconds = 0;
+    double tickSeconds = 0;
+    double plantPhaseSeconds = 0;
+    double herbivorePhaseSeconds = 0;
+    double omnivorePhaseSeconds = 0;
+    long peakRssKiB = 0;
+};
+
+static string optionValue(int argc, char **argv, int &argIndex) {
+    if (argIndex + 1 >= argc) {
+        cerr << "Missing value for option '" << argv[argIndex] << "'" << endl;
+        exit(-1);
+    }
+    argIndex++;
+    return argv[argIndex];
+}
+
+static double parseFraction(const string &optionName, const string &value) {
+    try {
+        double fraction = stod(value);
+        if (fraction >= 0 && fraction <= 1) {
+            return fraction;
+        }
+    } catch (logic_error &invalidValue) {
+        // Falls through to the error below
+    }
+    cerr << "Invalid value '" << value << "' for option '" << optionName << "', expected a fraction" << endl;
+    exit(-1);
+}
+
+static int parseCount(const string &optionName, const string &value, int minValue) {
+    try {
+        int count = stoi(value);
+        if (count >= minValue) {
+            return count;
+        }
+    } catch (logic_error &invalidValue) {
+        // Falls through to the error below
+    }
+    cerr << "Invalid value '" << value << "' for option '" << optionName << "'" << endl;
+    exit(-1);
+}
+
+static uint64_t parseSeed(const string &optionName, const string &value) {
+    try {
+        // stoull would wrap negative values around instead of rejecting them
+        size_t parsedLength = 0;
+        uint64_t seed = stoull(value, &parsedLength);
+        if (value.find('-') == string::npos && parsedLength == value.size()) {
+            return seed;
+        }
+    } catch (logic_error &invalidValue) {
+        // Falls through to the error below
+    }
+    cerr << "Invalid value '" << value << "' for option '" << optionName << "'" << endl;
+    exit(-1);
+}
+
+static BenchOptions parseBenchOptions(int argc, char **argv) {
+    BenchOptions options;
+    for (int argIndex = 1; argIndex < argc; argIndex++) {
+        string arg = argv[argIndex];
+        if (arg == "--sizes") {
+            // Comma separated list of square map side lengths
+            options.sizes.clear();
+            stringstream sizeList(optionValue(argc, argv, argIndex));
+            string size;
+            while (getline(sizeList, size, ',')) {
+                options.sizes.push_back(parseCount(arg, size, 1));
+            }
+        } else if (arg == "--species") {
+            options.speciesFilePath = optionValue(argc, argv, argIndex);
+        } else if (arg == "--csv") {
+            options.csvFilePath = optionValue(argc, argv, argIndex);
+        } else if (arg == "--terrain") {
+            options.terrainFraction = parseFraction(arg, optionValue(argc, argv, argIndex));
+        } else if (arg == "--plants") {
+            options.plantDensity = parseFraction(arg, optionValue(argc, argv, argIndex));
+        } else if (arg == "--herbivores") {
+            options.herbivoreDensity = parseFraction(arg, optionValue(argc, argv, argIndex));
+        } else if (arg == "--omnivores") {
+            options.omnivoreDensity = parseFraction(arg, optionValue(argc, argv, argIndex));
+        } else if (arg == "--ticks") {
+            options.ticks = parseCount(arg, optionValue(argc, argv, argIndex), 1);
+        } else if (arg == "--threads") {
+            options.threadCount = parseCount(arg, optionValue(argc, argv, argIndex), 1);
+        } else if (arg == "--seed") {
+            options.seed = parseSeed(arg, optionValue(argc, argv, argIndex));
+        } else {
+            cerr << "Unknown option '" << arg << "'" << endl;
+            exit(-1);
+        }
+    }
+
+    if (options.terrainFraction + options.plantDensity + options.herbivoreDensity + options.omnivoreDensity > 1) {
+        cerr << "Terrain fraction and species densities add up to more than the whole map" << endl;
+        exit(-1);
+    }
+    return options;
+}
+
+/**
+ * Writes a square map in the regular map file format. Every cell is decided by its own draw, so a world only
+ * depends on the seed and its size
+ * @param mapFilePath filepath to write the map to
+ * @param size side length of the map
+ * @param options terrain fraction, densities and seed
+ * @param speciesList species to place on the map
+ */
+static void generateMap(const string &mapFilePath, int size, const BenchOptions &options,
+                        const SpeciesTable &speciesList) {
+    // Each species type's density is shared evenly between its species
+    vector<char> speciesOfType[4];
+    for (size_t index = 0; index < speciesList.size(); index++) {
+        const Species &species = speciesList[(SpeciesIndex) index];
+        speciesOfType[species.speciesType].push_back(species.charID);
+    }
+    vector<pair<double, char>> cellChoices;
+    double threshold = options.terrainFraction / 2;
+    cellChoices.emplace_back(threshold, '~');
+    threshold += options.terrainFraction / 2;
+    cellChoices.emplace_back(threshold, '#');
+    pair<SpeciesType, double> densities[] = {{SpeciesType::PLANT,     options.plantDensity},
+                                             {SpeciesType::HERBIVORE, options.herbivoreDensity},
+                                             {SpeciesType::OMNIVORE,  options.omnivoreDensity}};
+    for (const auto &typeDensity: densities) {
+        for (char charID: speciesOfType[typeDensity.first]) {
+            threshold += typeDensity.second / speciesOfType[typeDensity.first].size();
+            cellChoices.emplace_back(threshold, charID);
+        }
+    }
+
+    ofstream mapFile(mapFilePath);
+    string mapLine(size, ' ');
+    for (int row = 0; row < size; row++) {
+        CounterRng rng(options.seed, (uint64_t) size, (uint32_t) row);
+        for (int column = 0; column < size; column++) {
+            double draw = rng.uniform();
+            mapLine[column] = ' ';
+            for (const auto &choice: cellChoices) {
+                if (draw < choice.first) {
+                    mapLine[column] = choice.second;
+                    break;
+                }
+            }
+        }
+        mapFile << mapLine << '\n';
+    }
+}
+
+static long peakRssKiB() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static double secondsSince(chrono::steady_clock::time_point startTime) {
+    return chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+}
+
+static BenchResult runBenchmark(int size, const BenchOptions &options, const SpeciesTable &speciesList) {
+    BenchResult result;
+    result.size = size;
+
+    string mapFilePath = (filesystem::temp_directory_path() / ("ecosim_bench_" + to_string(size) + ".txt")).string();
+    generateMap(mapFilePath, size, options, speciesList);
+
+    auto startTime = chrono::steady_clock::now();
+    SimUtilities::loadMap(mapFilePath, speciesList, options.threadCount);
+    result.loadSeconds = secondsSince(startTime);
+    filesystem::remove(mapFilePath);
+    result.elementCount = MapManager::entities().aliveCount();
+
+    TickEngine::setSeed(options.seed);
+    TickEngine::setTickCount(0);
+    TickEngine::setThreadCount(options.threadCount);
+
+    // Runs the phases the same way TickEngine::runTick does so each one can be timed
+    auto tickStartTime = chrono::steady_clock::now();
+    for (int tickNum = 0; tickNum < options.ticks; tickNum++) {
+        auto phaseStartTime = chrono::steady_clock::now();
+        TickEngine::runPlantPhase();
+        result.plantPhaseSeconds += secondsSince(phaseStartTime);
+
+        phaseStartTime = chrono::steady_clock::now();
+        TickEngine::runAnimalPhase(SpeciesType::HERBIVORE);
+        result.herbivorePhaseSeconds += secondsSince(phaseStartTime);
+
+        phaseStartTime = chrono::steady_clock::now();
+        TickEngine::runAnimalPhase(SpeciesType::OMNIVORE);
+        result.omnivorePhaseSeconds += secondsSince(phaseStartTime);
+
+        TickEngine::setTickCount(TickEngine::getTickCount() + 1);
+    }
+    result.tickSeconds = secondsSince(tickStartTime);
+    result.peakRssKiB = peakRssKiB();
+    return result;
+}
+
+int main(int argc, char **argv) {
+    BenchOptions options = parseBenchOptions(argc, argv);
+    SpeciesTable speciesList = SimUtilities::loadSpeciesList(options.speciesFilePath);
+
+    ofstream csvFile(options.csvFilePath);
+    if (!csvFile.is_open()) {
+        cerr << "Unable to open file '" << options.csvFilePath << "'" << endl;
+        exit(-1);
+    }
+    csvFile << "size,elements,threads,ticks,load_sec,tick_sec,ticks_per_sec,plant_sec,herbivore_sec,omnivore_sec,"
+               "peak_rss_kib" << endl;
+
+    vector<BenchResult> results;
+    for (int size: options.sizes) {
+        BenchResult result = runBenchmark(size, options, speciesList);
+        results.push_back(result);
+        csvFile << result.size << "," << result.elementCount << "," << options.threadCount << "," << options.ticks
+                << "," << result.loadSeconds << "," << result.tickSeconds << ","
+                << options.ticks / max(result.tickSeconds, 1e-9) << "," << result.plantPhaseSeconds << ","
+                << result.herbivorePhaseSeconds << "," << result.omnivorePhaseSeconds << "," << result.peakRssKiB
+                << endl;
+    }
+
+    cout << endl << setw(8) << "size" << setw(12) << "elements" << setw(10) << "load s" << setw(12) << "ticks/sec"
+         << setw(10) << "plant s" << setw(12) << "herbivore s" << setw(12) << "omnivore s" << setw(12) << "peak MiB"
+         << endl;
+    for (const BenchResult &result: results) {
+        cout << setw(8) << result.size << setw(12) << result.elementCount << fixed << setprecision(3) << setw(10)
+             << result.loadSeconds << setprecision(1) << setw(12) << options.ticks / max(result.tickSeconds, 1e-9)
+             << setprecision(3) << setw(10) << result.plantPhaseSeconds << setw(12) << result.herbivorePhaseSeconds
+             << setw(12) << result.omnivorePhaseSeconds << setprecision(1) << setw(12) << result.peakRssKiB / 1024.0
+             << endl;
+    }
+    cout << "Results written to " << options.csvFilePath << endl;
+    return 0;
+}
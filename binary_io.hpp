@@ -0,0 +1,148 @@
+#ifndef ECOSIM_BINARY_IO_HPP
+#define ECOSIM_BINARY_IO_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Writes values and whole arrays to a binary file in the machine's native byte order. Arrays are written with a
+ * single call each so large worlds are saved in a few bulk writes
+ */
+class BinaryWriter {
+public:
+    explicit BinaryWriter(const std::string &filePath) : file(filePath, std::ios::binary) {}
+
+    template<typename T>
+    void write(const T &value) {
+        static_assert(std::is_standard_layout<T>::value, "Only plain data can be written in binary form");
+        file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    /**
+     * Writes the element count of the array followed by its raw contents
+     * @param values array to write
+     */
+    template<typename T>
+    void writeArray(const std::vector<T> &values) {
+        static_assert(std::is_standard_layout<T>::value, "Only plain data can be written in binary form");
+        write((uint64_t) values.size());
+        file.write(reinterpret_cast<const char *>(values.data()), (std::streamsize) (values.size() * sizeof(T)));
+    }
+
+    /**
+     * Writes raw bytes with no element count
+     * @param bytes bytes to write
+     * @param byteCount number of bytes
+     */
+    void writeBytes(const void *bytes, size_t byteCount) {
+        file.write(reinterpret_cast<const char *>(bytes), (std::streamsize) byteCount);
+    }
+
+    bool good() const { return file.good(); }
+
+    /**
+     * Returns the number of bytes written so far
+     */
+    size_t position() { return (size_t) file.tellp(); }
+
+private:
+    std::ofstream file;
+};
+
+/**
+ * Reads back what BinaryWriter wrote. Every read is checked against the bytes left in the file, so a truncated or
+ * corrupt file makes the reader fail instead of allocating arbitrary amounts of memory
+ */
+class BinaryReader {
+public:
+    explicit BinaryReader(const std::string &filePath) : file(filePath, std::ios::binary | std::ios::ate) {
+        fileSize = file.is_open() ? (size_t) file.tellg() : 0;
+        remainingBytes = fileSize;
+        file.seekg(0);
+    }
+
+    template<typename T>
+    bool read(T &value) {
+        static_assert(std::is_standard_layout<T>::value, "Only plain data can be read in binary form");
+        return readBytes(reinterpret_cast<char *>(&value), sizeof(T));
+    }
+
+    /**
+     * Reads an array written by BinaryWriter::writeArray, replacing the contents of values
+     * @param values array to read into
+     * @return false if the file is too short or could not be read
+     */
+    template<typename T>
+    bool readArray(std::vector<T> &values) {
+        static_assert(std::is_standard_layout<T>::value, "Only plain data can be read in binary form");
+        uint64_t count;
+        if (!read(count) || count > remainingBytes / sizeof(T)) {
+            failed = true;
+            return false;
+        }
+        values.resize(count);
+        return readBytes(reinterpret_cast<char *>(values.data()), count * sizeof(T));
+    }
+
+    bool isOpen() const { return file.is_open(); }
+
+    bool good() const { return !failed && file.good(); }
+
+    bool atEnd() const { return remainingBytes == 0; }
+
+    size_t bytesLeft() const { return remainingBytes; }
+
+    size_t size() const { return fileSize; }
+
+    /**
+     * Continues reading at a byte offset from the start of the file
+     * @param offset offset to read from next
+     * @return false if the offset lies beyond the end of the file or the file could not be read
+     */
+    bool seek(size_t offset) {
+        if (failed || offset > fileSize) {
+            failed = true;
+            return false;
+        }
+        file.clear();
+        file.seekg((std::streamoff) offset);
+        remainingBytes = fileSize - offset;
+        failed = !file.good();
+        return !failed;
+    }
+
+    /**
+     * Reads raw bytes up to the end of the file
+     * @param destination buffer to read into
+     * @param maxBytes size of the buffer
+     * @return number of bytes read, 0 if the file is exhausted or could not be read
+     */
+    size_t readAvailable(void *destination, size_t maxBytes) {
+        size_t byteCount = std::min(maxBytes, remainingBytes);
+        return readBytes(reinterpret_cast<char *>(destination), byteCount) ? byteCount : 0;
+    }
+
+private:
+    bool readBytes(char *destination, size_t byteCount) {
+        if (failed || byteCount > remainingBytes) {
+            failed = true;
+            return false;
+        }
+        file.read(destination, (std::streamsize) byteCount);
+        remainingBytes -= byteCount;
+        failed = !file.good();
+        return !failed;
+    }
+
+    std::ifstream file;
+    size_t fileSize = 0;
+    size_t remainingBytes = 0;
+    bool failed = false;
+};
+
+#endif //ECOSIM_BINARY_IO_HPP
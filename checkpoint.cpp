@@ -0,0 +1,148 @@
+#include "checkpoint.hpp"
+
+#include <cstring>
+
+#include "binary_io.hpp"
+#include "map_manager.hpp"
+#include "tick_engine.hpp"
+#include "trace_recorder.hpp"
+
+/**
+ * Fixed-size start of every checkpoint
+ */
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    int32_t rows;
+    int32_t columns;
+    int64_t tickCount;
+    uint64_t seed;
+};
+
+static const char CHECKPOINT_MAGIC[8] = {'E', 'C', 'O', 'S', 'I', 'M', 'C', 'K'};
+
+bool Checkpoint::save(const std::string &filePath, const World &world) {
+    TraceSpan saveSpan("save checkpoint");
+    BinaryWriter writer(filePath);
+    if (!writer.good()) {
+        return false;
+    }
+
+    CheckpointHeader header{};
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = FORMAT_VERSION;
+    header.rows = world.mapRows;
+    header.columns = world.mapColumns;
+    header.tickCount = world.tickCount;
+    header.seed = world.seed;
+    writer.write(header);
+
+    writer.write((uint32_t) world.species.size());
+    for (size_t index = 0; index < world.species.size(); index++) {
+        const Species &species = world.species[(SpeciesIndex) index];
+        writer.write(species.charID);
+        writer.write((int32_t) species.speciesType);
+        writer.write((int32_t) species.regrowthCoeff);
+        writer.write((int32_t) species.energy);
+        writer.write((int16_t) species.colorPair);
+        writer.writeArray(species.foodChain);
+    }
+
+    world.terrain.writeTo(writer);
+    world.entities.writeTo(writer);
+    world.events.writeTo(writer);
+    return writer.good();
+}
+
+/**
+ * Reads the species table of a checkpoint
+ * @param reader checkpoint being read
+ * @param speciesList table to add the species to
+ * @return false if the data could not be read or holds an invalid species
+ */
+static bool readSpecies(BinaryReader &reader, SpeciesTable &speciesList) {
+    uint32_t speciesCount;
+    if (!reader.read(speciesCount) || speciesCount > SpeciesTable::MAX_SPECIES) {
+        return false;
+    }
+
+    for (uint32_t index = 0; index < speciesCount; index++) {
+        Species species;
+        int32_t speciesType, regrowthCoeff, energy;
+        int16_t colorPair;
+        if (!reader.read(species.charID) || !reader.read(speciesType) || !reader.read(regrowthCoeff) ||
+            !reader.read(energy) || !reader.read(colorPair) || !reader.readArray(species.foodChain)) {
+            return false;
+        }
+        if (speciesType < SpeciesType::PLANT || speciesType > SpeciesType::OMNIVORE ||
+            speciesList.indexOf(species.charID) != -1) {
+            return false;
+        }
+        species.speciesType = (SpeciesType) speciesType;
+        species.regrowthCoeff = regrowthCoeff;
+        species.energy = energy;
+        species.colorPair = colorPair;
+        speciesList.add(species);
+    }
+    return true;
+}
+
+/**
+ * Checks that every living element of the restored store lies on the map and belongs to a known species
+ * @return true if every element can be placed on the grid
+ */
+static bool entitiesFitWorld() {
+    bool entitiesFit = true;
+    for (size_t index = 0; index < SpeciesTable::MAX_SPECIES; index++) {
+        const vector<EntityId> &members = MapManager::entities().membersOf((SpeciesIndex) index);
+        if (index >= MapManager::species().size()) {
+            entitiesFit &= members.empty();
+            continue;
+        }
+        for (EntityId id: members) {
+            entitiesFit &= MapManager::entities().isAlive(id) && MapManager::entities().getSpecies(id) == index &&
+                           MapManager::floraFauna().inBounds(MapManager::entities().getLocation(id));
+        }
+    }
+    return entitiesFit;
+}
+
+bool Checkpoint::restore(const std::string &filePath) {
+    TraceSpan restoreSpan("restore checkpoint");
+    BinaryReader reader(filePath);
+    CheckpointHeader header{};
+    if (!reader.isOpen() || !reader.read(header) ||
+        memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 || header.version != FORMAT_VERSION ||
+        header.rows < 0 || header.columns < 0 || header.tickCount < 0) {
+        return false;
+    }
+    // The packed terrain holds a quarter byte per cell, so a file too short for its claimed dimensions is rejected
+    // before anything is allocated for them. Rows and columns are both below 2^31, so their product cannot overflow
+    uint64_t cellCount = (uint64_t) header.rows * (uint64_t) header.columns;
+    if ((cellCount + 3) / 4 > reader.bytesLeft()) {
+        return false;
+    }
+
+    SpeciesTable speciesList;
+    bool restoreOk = readSpecies(reader, speciesList);
+    if (restoreOk) {
+        MapManager::resetWorld(header.rows, header.columns);
+        MapManager::species() = speciesList;
+        restoreOk = MapManager::terrain().readFrom(reader) && MapManager::entities().readFrom(reader) &&
+                    MapManager::events().readFrom(reader) && entitiesFitWorld() &&
+                    MapManager::floraFauna().rebuildFrom(MapManager::entities(), MapManager::species());
+    }
+    if (!restoreOk) {
+        MapManager::resetWorld(0, 0);
+        MapManager::species() = SpeciesTable();
+        return false;
+    }
+
+    // The pending buffers start out identical to the committed state
+    MapManager::nextFloraFauna().rebuildFrom(MapManager::entities(), MapManager::species());
+    MapManager::nextEntities() = MapManager::entities();
+
+    TickEngine::setTickCount(header.tickCount);
+    TickEngine::setSeed(header.seed);
+    return true;
+}
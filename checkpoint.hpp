@@ -0,0 +1,40 @@
+#ifndef ECOSIM_CHECKPOINT_HPP
+#define ECOSIM_CHECKPOINT_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "world.hpp"
+
+/**
+ * Binary checkpoints of the whole simulation: map dimensions, species table, terrain, every entity slot with its
+ * energy and growth state, scheduled regrowth events, the tick count and the seed. Animal decisions only depend on
+ * the seed and tick, so a restored run continues exactly like the run that was saved.
+ *
+ * Every array is stored as one contiguous block, so saving and restoring take a handful of bulk writes and reads.
+ * The grid itself is not stored since it is rebuilt from the entity locations. Checkpoints use the machine's native
+ * byte order and start with a magic number and format version that are checked on restore
+ */
+class Checkpoint {
+public:
+    /**
+     * Saves the committed state of a world. Must be called between ticks
+     * @param filePath filepath to write the checkpoint to
+     * @param world world to save, which is only read and need not be current
+     * @return false if the file could not be written
+     */
+    static bool save(const std::string &filePath, const World &world = World::current());
+
+    /**
+     * Replaces the simulation with the state stored in a checkpoint, including the tick count and seed
+     * @param filePath filepath to read the checkpoint from
+     * @return false if the file could not be read, is not a checkpoint of this version or is inconsistent. The
+     * world is left untouched if the header is rejected and empty if the rest of the file is
+     */
+    static bool restore(const std::string &filePath);
+
+    // Version 2 writes entity pools field by field instead of as raw structs, version 3 scheduled events as well
+    static const uint32_t FORMAT_VERSION = 3;
+};
+
+#endif //ECOSIM_CHECKPOINT_HPP
@@ -0,0 +1,82 @@
+#ifndef ECOSIM_COUNTER_RNG_HPP
+#define ECOSIM_COUNTER_RNG_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Counter-based random number generator built on Philox4x32-10. Every value is a pure function of the run seed, the
+ * tick, the element id and how many values the element drew before it, so the generator holds no shared state and
+ * a run does not depend on the order in which elements are ticked or on the number of threads ticking them.
+ *
+ * A generator is meant to be constructed on the stack for one element's turn and thrown away afterwards
+ */
+class CounterRng {
+public:
+    using result_type = uint32_t;
+
+    /**
+     * @param seed seed of the simulation run
+     * @param tick tick the values are drawn for
+     * @param id element the values are drawn for
+     */
+    CounterRng(uint64_t seed, uint64_t tick, uint32_t id)
+            : key{(uint32_t) seed, (uint32_t) (seed >> 32)}, tick(tick), id(id) {}
+
+    /**
+     * Returns the next 32 random bits
+     * @return uniformly distributed value
+     */
+    uint32_t operator()() {
+        // Each Philox block yields four values, the next block is only computed once they are used up
+        if (drawIndex % 4 == 0) {
+            block = philox({(uint32_t) (drawIndex / 4), id, (uint32_t) tick, (uint32_t) (tick >> 32)}, key);
+        }
+        return block[drawIndex++ % 4];
+    }
+
+    /**
+     * Returns a value uniformly distributed in [0, bound)
+     * @param bound exclusive upper bound, must not be zero
+     * @return random value
+     */
+    size_t below(size_t bound) { return (size_t) (((uint64_t) (*this)() * bound) >> 32); }
+
+    /**
+     * Returns a value uniformly distributed in [0, 1)
+     * @return random value
+     */
+    double uniform() { return (*this)() * (1.0 / 4294967296.0); }
+
+    static constexpr uint32_t min() { return 0; }
+
+    static constexpr uint32_t max() { return UINT32_MAX; }
+
+    /**
+     * Philox4x32 block function with 10 rounds
+     * @param counter 128 bit counter
+     * @param key 64 bit key
+     * @return 128 bits of random output
+     */
+    static std::array<uint32_t, 4> philox(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key) {
+        for (int round = 0; round < 10; round++) {
+            uint64_t product0 = (uint64_t) 0xD2511F53 * counter[0];
+            uint64_t product1 = (uint64_t) 0xCD9E8D57 * counter[2];
+            counter = {(uint32_t) (product1 >> 32) ^ counter[1] ^ key[0], (uint32_t) product1,
+                       (uint32_t) (product0 >> 32) ^ counter[3] ^ key[1], (uint32_t) product0};
+            key[0] += 0x9E3779B9;
+            key[1] += 0xBB67AE85;
+        }
+        return counter;
+    }
+
+private:
+    std::array<uint32_t, 2> key;
+    uint64_t tick;
+    uint32_t id;
+    uint32_t drawIndex = 0;
+    std::array<uint32_t, 4> block{};
+};
+
+#endif //ECOSIM_COUNTER_RNG_HPP
@@ -0,0 +1,179 @@
+#include "ecosim.h"
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "checkpoint.hpp"
+#include "map_manager.hpp"
+#include "sim_utilities.hpp"
+#include "tick_engine.hpp"
+#include "world.hpp"
+
+/**
+ * World handed out through the C interface
+ */
+struct EcoSimWorld {
+    World world;
+    int threadCount = 1;
+};
+
+// Description of the last failed call of each thread
+static thread_local std::string lastError;
+
+/**
+ * Records why a call failed
+ * @param status status the call returns
+ * @param message description of the failure
+ * @return status
+ */
+static EcoSimStatus fail(EcoSimStatus status, const std::string &message) {
+    lastError = message;
+    return status;
+}
+
+EcoSimStatus ecosimCreateWorld(const char *mapText, size_t mapLength, const char *speciesText, size_t speciesLength,
+                               uint64_t seed, int threadCount, EcoSimWorld **world) {
+    if (world == nullptr || (mapText == nullptr && mapLength > 0) || (speciesText == nullptr && speciesLength > 0)) {
+        return fail(ECOSIM_INVALID_ARGUMENT, "Null world, map or species pointer");
+    }
+    *world = nullptr;
+
+    try {
+        auto handle = std::make_unique<EcoSimWorld>();
+        handle->threadCount = std::max(1, threadCount);
+        WorldScope worldScope(handle->world);
+
+        std::istringstream speciesStream(std::string(speciesText != nullptr ? speciesText : "", speciesLength));
+        SpeciesTable speciesList;
+        if (!SimUtilities::parseSpeciesList(speciesStream, speciesList)) {
+            return fail(ECOSIM_INVALID_INPUT,
+                        "Too many species, at most " + std::to_string(SpeciesTable::MAX_SPECIES) + " are supported");
+        }
+        std::string errorMessage;
+        if (!SimUtilities::loadMapFromMemory(mapText, mapLength, speciesList, handle->threadCount, errorMessage)) {
+            return fail(ECOSIM_INVALID_INPUT, errorMessage);
+        }
+        TickEngine::setSeed(seed);
+        TickEngine::setThreadCount(handle->threadCount);
+
+        *world = handle.release();
+        return ECOSIM_OK;
+    } catch (const std::invalid_argument &) {
+        return fail(ECOSIM_INVALID_INPUT, "Species definition with a trait that is not a number");
+    } catch (const std::out_of_range &) {
+        return fail(ECOSIM_INVALID_INPUT, "Species definition with a trait that is out of range");
+    } catch (const std::exception &exception) {
+        return fail(ECOSIM_INTERNAL_ERROR, exception.what());
+    }
+}
+
+void ecosimDestroyWorld(EcoSimWorld *world) {
+    delete world;
+}
+
+EcoSimStatus ecosimStep(EcoSimWorld *world, int64_t ticks) {
+    if (world == nullptr || ticks < 0) {
+        return fail(ECOSIM_INVALID_ARGUMENT, "Null world or negative tick count");
+    }
+
+    try {
+        WorldScope worldScope(world->world);
+        for (int64_t tick = 0; tick < ticks; tick++) {
+            TickEngine::runTick();
+        }
+    } catch (const std::exception &exception) {
+        return fail(ECOSIM_INTERNAL_ERROR, exception.what());
+    }
+    return ECOSIM_OK;
+}
+
+int64_t ecosimTickCount(const EcoSimWorld *world) {
+    return world != nullptr ? world->world.tickCount : 0;
+}
+
+void ecosimMapSize(const EcoSimWorld *world, int32_t *rows, int32_t *columns) {
+    if (rows != nullptr) {
+        *rows = world != nullptr ? world->world.mapRows : 0;
+    }
+    if (columns != nullptr) {
+        *columns = world != nullptr ? world->world.mapColumns : 0;
+    }
+}
+
+size_t ecosimSpeciesCount(const EcoSimWorld *world) {
+    return world != nullptr ? world->world.species.size() : 0;
+}
+
+char ecosimSpeciesChar(const EcoSimWorld *world, size_t speciesIndex) {
+    if (world == nullptr || speciesIndex >= world->world.species.size()) {
+        return 0;
+    }
+    return world->world.species[(SpeciesIndex) speciesIndex].charID;
+}
+
+size_t ecosimPopulations(const EcoSimWorld *world, uint64_t *populations, size_t capacity) {
+    if (world == nullptr) {
+        return 0;
+    }
+    size_t speciesCount = world->world.species.size();
+    for (size_t index = 0; index < speciesCount && index < capacity && populations != nullptr; index++) {
+        populations[index] = world->world.entities.countOf((SpeciesIndex) index);
+    }
+    return speciesCount;
+}
+
+EcoSimStatus ecosimReadCells(const EcoSimWorld *world, int32_t x, int32_t y, int32_t width, int32_t height,
+                             char *cells) {
+    if (world == nullptr || cells == nullptr || x < 0 || y < 0 || width < 0 || height < 0 ||
+        (int64_t) x + width > world->world.mapColumns || (int64_t) y + height > world->world.mapRows) {
+        return fail(ECOSIM_INVALID_ARGUMENT, "Null world or buffer, or a rectangle that does not lie on the map");
+    }
+
+    const World &state = world->world;
+    for (int32_t row = y; row < y + height; row++) {
+        for (int32_t column = x; column < x + width; column++) {
+            Point location(column, row);
+            EntityId visibleElement = state.floraFauna.topElement(location);
+            *cells++ = visibleElement != NO_ENTITY ? state.species[state.entities.getSpecies(visibleElement)].charID
+                                                   : TerrainRaster::toChar(state.terrain.get(location));
+        }
+    }
+    return ECOSIM_OK;
+}
+
+EcoSimStatus ecosimSave(const EcoSimWorld *world, const char *filePath) {
+    if (world == nullptr || filePath == nullptr) {
+        return fail(ECOSIM_INVALID_ARGUMENT, "Null world or filepath");
+    }
+
+    if (!Checkpoint::save(filePath, world->world)) {
+        return fail(ECOSIM_IO_ERROR, "Unable to write checkpoint '" + std::string(filePath) + "'");
+    }
+    return ECOSIM_OK;
+}
+
+EcoSimStatus ecosimRestore(EcoSimWorld *world, const char *filePath) {
+    if (world == nullptr || filePath == nullptr) {
+        return fail(ECOSIM_INVALID_ARGUMENT, "Null world or filepath");
+    }
+
+    try {
+        WorldScope worldScope(world->world);
+        bool restored = Checkpoint::restore(filePath);
+        // Like a run resumed with --resume, the restored world is sized for the thread count again
+        TickEngine::setThreadCount(world->threadCount);
+        if (!restored) {
+            return fail(ECOSIM_INVALID_INPUT, "Unable to restore checkpoint '" + std::string(filePath) + "'");
+        }
+    } catch (const std::exception &exception) {
+        return fail(ECOSIM_INTERNAL_ERROR, exception.what());
+    }
+    return ECOSIM_OK;
+}
+
+const char *ecosimLastError(void) {
+    return lastError.c_str();
+}
@@ -0,0 +1,148 @@
+#ifndef ECOSIM_ECOSIM_H
+#define ECOSIM_ECOSIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * C interface of the simulation core, for hosts that drive simulations in-process instead of running EcoSim. Worlds
+ * are built from the text of a map and a species file held in memory, stepped any number of ticks per call and read
+ * back into buffers owned by the caller. Reading never allocates. Stepping reuses scratch buffers kept in the world,
+ * so once a world has run a few ticks it only allocates when a population or the event schedule outgrows its earlier
+ * peak. Nothing is printed and curses is never used.
+ *
+ * Every world holds its own simulation state, thread pool and per-worker buffers. Different worlds may be used from
+ * different threads at the same time, but a single world must only be used from one thread at a time. The files of
+ * the population recorder, action log and trace recorder are process-wide rather than part of a world: the library
+ * never starts them, but a host that does records every world stepped in the process into the same recording.
+ * Functions returning a status leave a description of the failure in ecosimLastError
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct EcoSimWorld EcoSimWorld;
+
+typedef enum EcoSimStatus {
+    ECOSIM_OK = 0,
+    // A pointer was null, a count was negative or a rectangle does not lie on the map
+    ECOSIM_INVALID_ARGUMENT = 1,
+    // The map, species definitions or checkpoint were rejected
+    ECOSIM_INVALID_INPUT = 2,
+    // A checkpoint could not be written
+    ECOSIM_IO_ERROR = 3,
+    // The simulation failed unexpectedly, for instance by running out of memory
+    ECOSIM_INTERNAL_ERROR = 4
+} EcoSimStatus;
+
+/**
+ * Creates a world from a map and species definitions in the formats of map and species files
+ * @param mapText characters of the map, run-length encoded maps are accepted as well
+ * @param mapLength number of bytes in mapText
+ * @param speciesText species definitions, one species per line
+ * @param speciesLength number of bytes in speciesText
+ * @param seed seed every decision of the run is derived from
+ * @param threadCount number of threads the world's ticks run on
+ * @param world set to the new world, or to null if it could not be created
+ * @return ECOSIM_OK, or ECOSIM_INVALID_INPUT if the map or species definitions are rejected
+ */
+EcoSimStatus ecosimCreateWorld(const char *mapText, size_t mapLength, const char *speciesText, size_t speciesLength,
+                               uint64_t seed, int threadCount, EcoSimWorld **world);
+
+/**
+ * Destroys a world and stops its threads. Null is ignored
+ * @param world world to destroy
+ */
+void ecosimDestroyWorld(EcoSimWorld *world);
+
+/**
+ * Runs ticks of a world
+ * @param world world to run
+ * @param ticks number of ticks to run
+ * @return ECOSIM_OK once every tick has run
+ */
+EcoSimStatus ecosimStep(EcoSimWorld *world, int64_t ticks);
+
+/**
+ * Returns the number of ticks a world has run, including ticks run before the checkpoint it was restored from
+ * @param world world to query
+ * @return tick count
+ */
+int64_t ecosimTickCount(const EcoSimWorld *world);
+
+/**
+ * Returns the size of a world's map
+ * @param world world to query
+ * @param rows set to the number of rows
+ * @param columns set to the number of columns
+ */
+void ecosimMapSize(const EcoSimWorld *world, int32_t *rows, int32_t *columns);
+
+/**
+ * Returns the number of species of a world. Species are indexed in the order of the species definitions
+ * @param world world to query
+ * @return species count
+ */
+size_t ecosimSpeciesCount(const EcoSimWorld *world);
+
+/**
+ * Returns the map character of a species
+ * @param world world to query
+ * @param speciesIndex index of the species
+ * @return character of the species, or 0 if there is no such species
+ */
+char ecosimSpeciesChar(const EcoSimWorld *world, size_t speciesIndex);
+
+/**
+ * Copies the number of living elements of every species
+ * @param world world to query
+ * @param populations buffer indexed by species index, filled up to its capacity
+ * @param capacity number of entries in populations
+ * @return number of species, which may be more than were copied
+ */
+size_t ecosimPopulations(const EcoSimWorld *world, uint64_t *populations, size_t capacity);
+
+/**
+ * Copies a rectangle of the map as the characters a saved map would hold: the species character of the element on
+ * top of each cell, the terrain character or a space
+ * @param world world to read
+ * @param x column of the rectangle's left edge
+ * @param y row of the rectangle's top edge
+ * @param width number of columns to copy
+ * @param height number of rows to copy
+ * @param cells buffer of width * height characters that receives the rectangle row by row
+ * @return ECOSIM_OK, or ECOSIM_INVALID_ARGUMENT if the rectangle does not lie on the map
+ */
+EcoSimStatus ecosimReadCells(const EcoSimWorld *world, int32_t x, int32_t y, int32_t width, int32_t height,
+                             char *cells);
+
+/**
+ * Writes a checkpoint of a world, in the format of --save-checkpoint
+ * @param world world to save
+ * @param filePath filepath to write the checkpoint to
+ * @return ECOSIM_OK, or ECOSIM_IO_ERROR if the file could not be written
+ */
+EcoSimStatus ecosimSave(const EcoSimWorld *world, const char *filePath);
+
+/**
+ * Replaces a world with the state stored in a checkpoint, including its tick count and seed. The world keeps its
+ * thread count
+ * @param world world to replace
+ * @param filePath filepath of a checkpoint written by ecosimSave or --save-checkpoint
+ * @return ECOSIM_OK, or ECOSIM_INVALID_INPUT if the checkpoint could not be read. The world is left untouched if
+ * the checkpoint is not one of this version and empty if its contents are rejected
+ */
+EcoSimStatus ecosimRestore(EcoSimWorld *world, const char *filePath);
+
+/**
+ * Returns a description of the last failed call made on the calling thread
+ * @return message that stays valid until the next failing call on the thread, empty if no call failed yet
+ */
+const char *ecosimLastError(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ECOSIM_ECOSIM_H
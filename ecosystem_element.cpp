@@ -1 +0,0 @@
-#include "ecosystem_element.hpp"
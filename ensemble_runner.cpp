@@ -0,0 +1,145 @@
+#include "ensemble_runner.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <thread>
+
+#include "action_log.hpp"
+#include "population_recorder.hpp"
+#include "tick_engine.hpp"
+#include "trace_recorder.hpp"
+
+bool EnsembleRunner::canOverride(const SpeciesTable &worldSpecies, const SpeciesTable &overrides) {
+    for (size_t index = 0; index < overrides.size(); index++) {
+        const Species &override = overrides[(SpeciesIndex) index];
+        int worldIndex = worldSpecies.indexOf(override.charID);
+        if (worldIndex >= 0 && worldSpecies[(SpeciesIndex) worldIndex].speciesType != override.speciesType) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void EnsembleRunner::applyOverrides(World &world, const SpeciesTable &overrides) {
+    for (size_t index = 0; index < overrides.size(); index++) {
+        const Species &override = overrides[(SpeciesIndex) index];
+        if (world.species.indexOf(override.charID) >= 0) {
+            world.species.add(override);
+        }
+    }
+
+    // Both buffers hold the same elements between phases, so they are changed alike and left without changes
+    for (size_t index = 0; index < world.species.size(); index++) {
+        const Species &species = world.species[(SpeciesIndex) index];
+        for (EntityId id: world.entities.membersOf((SpeciesIndex) index)) {
+            int energy = species.speciesType == SpeciesType::PLANT ? species.energy
+                                                                   : std::min(world.entities.getEnergy(id),
+                                                                              species.energy);
+            world.entities.setEnergy(id, energy);
+            world.nextEntities.setEnergy(id, energy);
+        }
+    }
+    world.entities.clearChanges();
+    world.nextEntities.clearChanges();
+}
+
+std::vector<ReplicaResult> EnsembleRunner::run(const World &initialWorld, const std::vector<SpeciesTable> &variants,
+                                               const std::vector<ReplicaSettings> &replicas, int ticks,
+                                               int threadCount) {
+    if (PopulationRecorder::isRecording() || ActionLog::isRecording()) {
+        return {};
+    }
+    std::vector<ReplicaResult> results(replicas.size());
+    std::atomic<size_t> nextReplica(0);
+
+    // Threads take the next replica that has not been started until every replica has run
+    auto runReplicas = [&]() {
+        for (size_t replica = nextReplica++; replica < replicas.size(); replica = nextReplica++) {
+            TraceSpan replicaSpan("replica", (int64_t) replica);
+            auto startTime = std::chrono::steady_clock::now();
+            const ReplicaSettings &settings = replicas[replica];
+            World world = initialWorld;
+            WorldScope worldScope(world);
+            world.seed = settings.seed;
+            if (!variants[settings.variant].empty()) {
+                applyOverrides(world, variants[settings.variant]);
+            }
+            for (int tickNum = 0; tickNum < ticks; tickNum++) {
+                TickEngine::runTick();
+            }
+
+            ReplicaResult &result = results[replica];
+            result.settings = settings;
+            for (size_t index = 0; index < world.species.size(); index++) {
+                const std::vector<EntityId> &members = world.entities.membersOf((SpeciesIndex) index);
+                int64_t totalEnergy = 0;
+                for (EntityId id: members) {
+                    totalEnergy += world.entities.getEnergy(id);
+                }
+                result.populations.push_back(members.size());
+                result.totalEnergies.push_back(totalEnergy);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+            result.seconds = elapsed.count();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int threadIndex = 1; threadIndex < std::min(threadCount, (int) replicas.size()); threadIndex++) {
+        threads.emplace_back([&runReplicas, threadIndex]() {
+            TraceRecorder::setThreadName("ensemble worker " + std::to_string(threadIndex));
+            runReplicas();
+        });
+    }
+    runReplicas();
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+    return results;
+}
+
+void EnsembleRunner::printSummary(std::ostream &outputStream, const std::vector<ReplicaResult> &results,
+                                  const SpeciesTable &species, const std::vector<std::string> &variantNames) {
+    for (size_t variant = 0; variant < variantNames.size(); variant++) {
+        std::vector<const ReplicaResult *> variantResults;
+        for (const ReplicaResult &result: results) {
+            if (result.settings.variant == variant) {
+                variantResults.push_back(&result);
+            }
+        }
+        if (variantResults.empty()) {
+            continue;
+        }
+
+        outputStream << variantNames[variant] << ": " << variantResults.size() << " replicas" << std::endl;
+        outputStream << std::setw(10) << "species" << std::setw(12) << "mean" << std::setw(12) << "stddev"
+                     << std::setw(10) << "min" << std::setw(10) << "max" << std::setw(10) << "extinct"
+                     << std::setw(14) << "mean energy" << std::endl;
+        for (size_t index = 0; index < species.size(); index++) {
+            double populationSum = 0;
+            double squareSum = 0;
+            double energySum = 0;
+            size_t minPopulation = variantResults[0]->populations[index];
+            size_t maxPopulation = minPopulation;
+            size_t extinctCount = 0;
+            for (const ReplicaResult *result: variantResults) {
+                size_t population = result->populations[index];
+                populationSum += (double) population;
+                squareSum += (double) population * (double) population;
+                energySum += (double) result->totalEnergies[index];
+                minPopulation = std::min(minPopulation, population);
+                maxPopulation = std::max(maxPopulation, population);
+                extinctCount += population == 0;
+            }
+            double mean = populationSum / (double) variantResults.size();
+            double variance = std::max(0.0, squareSum / (double) variantResults.size() - mean * mean);
+            outputStream << std::setw(10) << species[(SpeciesIndex) index].charID << std::fixed << std::setprecision(1)
+                         << std::setw(12) << mean << std::setw(12) << std::sqrt(variance) << std::setw(10)
+                         << minPopulation << std::setw(10) << maxPopulation << std::setw(10) << extinctCount
+                         << std::setw(14) << (populationSum > 0 ? energySum / populationSum : 0.0) << std::endl;
+        }
+    }
+}
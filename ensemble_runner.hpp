@@ -0,0 +1,85 @@
+#ifndef ECOSIM_ENSEMBLE_RUNNER_HPP
+#define ECOSIM_ENSEMBLE_RUNNER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "species_table.hpp"
+#include "world.hpp"
+
+/**
+ * Settings of one replica of an ensemble
+ */
+struct ReplicaSettings {
+    uint64_t seed = 0;
+    // Index of the species variant the replica runs with
+    size_t variant = 0;
+};
+
+/**
+ * Final state of one replica
+ */
+struct ReplicaResult {
+    ReplicaSettings settings;
+    double seconds = 0;
+    // Living elements and their total energy, indexed by species index
+    std::vector<size_t> populations;
+    std::vector<int64_t> totalEnergies;
+};
+
+/**
+ * Runs independent replicas of a loaded world side by side in one process. Every replica is a copy of the world
+ * with its own seed and optionally its own species constants, and runs on a single thread, so the replicas of an
+ * ensemble are spread over the threads and the map and species files are only parsed once.
+ *
+ * Action logs and population recordings follow whichever world calls into them, so replicas would write into a
+ * running recording. Ensembles are refused while either recorder runs
+ */
+class EnsembleRunner {
+public:
+    /**
+     * Checks whether an override table can be applied to the species of a world. Only species the world already has
+     * are overridden, and a species may not change its type
+     * @param worldSpecies species of the world
+     * @param overrides species with new constants
+     * @return false if an override changes the type of a species
+     */
+    static bool canOverride(const SpeciesTable &worldSpecies, const SpeciesTable &overrides);
+
+    /**
+     * Replaces the constants of the world's species with those of the species with the same character ID in the
+     * override table. Plants take on the new energy of their species, animals keep theirs up to the new maximum
+     * @param world world to change
+     * @param overrides species with new constants, checked with canOverride
+     */
+    static void applyOverrides(World &world, const SpeciesTable &overrides);
+
+    /**
+     * Runs every replica for the given number of ticks and waits for all of them to finish
+     * @param initialWorld world every replica starts from, left untouched
+     * @param variants species overrides the replicas choose from, an empty table keeps the world's species
+     * @param replicas settings of every replica
+     * @param ticks number of ticks every replica runs
+     * @param threadCount number of replicas that run at the same time
+     * @return results in the order of the replicas, empty without running any replica if an action log or population
+     * recording is running
+     */
+    static std::vector<ReplicaResult> run(const World &initialWorld, const std::vector<SpeciesTable> &variants,
+                                          const std::vector<ReplicaSettings> &replicas, int ticks, int threadCount);
+
+    /**
+     * Prints the mean, standard deviation, minimum and maximum final population, the number of replicas it died
+     * out in and the mean energy of every species, separately for every variant
+     * @param outputStream stream to print the summary to
+     * @param results results of every replica
+     * @param species species of the initial world
+     * @param variantNames name of every variant
+     */
+    static void printSummary(std::ostream &outputStream, const std::vector<ReplicaResult> &results,
+                             const SpeciesTable &species, const std::vector<std::string> &variantNames);
+};
+
+#endif //ECOSIM_ENSEMBLE_RUNNER_HPP
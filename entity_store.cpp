@@ -0,0 +1,261 @@
+#include "entity_store.hpp"
+
+#include <algorithm>
+
+EntityId EntityStore::create(SpeciesIndex speciesIndex, const Point &location, int energy) {
+    if (speciesMembers.size() <= speciesIndex) {
+        speciesMembers.resize(speciesIndex + 1);
+        pools.resize(speciesIndex + 1);
+    }
+    SpeciesPool &pool = pools[speciesIndex];
+    if (pool.freeHead == NO_ENTITY) {
+        addSlab(speciesIndex);
+    }
+
+    EntityId id = pool.freeHead;
+    pool.freeHead = nextFree[id];
+    pool.highWater = std::max(pool.highWater, speciesMembers[speciesIndex].size() + 1);
+    locations[id] = location;
+    energies[id] = energy;
+    nextFree[id] = NO_ENTITY;
+
+    memberPositions[id] = (uint32_t) speciesMembers[speciesIndex].size();
+    speciesMembers[speciesIndex].push_back(id);
+    markMemberChanged(speciesIndex, memberPositions[id]);
+
+    // Every element starts alive, plants start fully grown
+    flags[id] = ALIVE | GROWN;
+    livingCount++;
+    markChanged(id);
+    return id;
+}
+
+void EntityStore::destroy(EntityId id) {
+    flags[id] = 0;
+    destroyedIds[ThreadPool::workerIndex()].push_back(id);
+    markChanged(id);
+}
+
+void EntityStore::releaseDestroyed() {
+    // Gather every worker's destructions into the first log and release them from the highest id down, so the
+    // lowest ids end up at the head of the free list
+    std::vector<EntityId> &releasedIds = destroyedIds[0];
+    for (size_t worker = 1; worker < destroyedIds.size(); worker++) {
+        releasedIds.insert(releasedIds.end(), destroyedIds[worker].begin(), destroyedIds[worker].end());
+        destroyedIds[worker].clear();
+    }
+    std::sort(releasedIds.begin(), releasedIds.end());
+
+    for (auto idIter = releasedIds.rbegin(); idIter != releasedIds.rend(); ++idIter) {
+        removeMember(*idIter);
+        SpeciesPool &pool = pools[speciesIndices[*idIter]];
+        nextFree[*idIter] = pool.freeHead;
+        pool.freeHead = *idIter;
+        markChanged(*idIter);
+    }
+    livingCount -= releasedIds.size();
+    releasedIds.clear();
+}
+
+void EntityStore::addSlab(SpeciesIndex speciesIndex) {
+    // Slots of a new slab are chained lowest id first, so a species fills its slab in id order
+    auto firstId = (EntityId) flags.size();
+    size_t slotCount = flags.size() + SLAB_SIZE;
+    locations.resize(slotCount);
+    speciesIndices.resize(slotCount, speciesIndex);
+    energies.resize(slotCount, 0);
+    flags.resize(slotCount, 0);
+    nextFree.resize(slotCount, NO_ENTITY);
+    memberPositions.resize(slotCount, 0);
+    for (EntityId id = firstId; id < (EntityId) slotCount; id++) {
+        nextFree[id] = id + 1 < (EntityId) slotCount ? id + 1 : NO_ENTITY;
+        markChanged(id);
+    }
+    pools[speciesIndex].freeHead = firstId;
+    pools[speciesIndex].capacity += SLAB_SIZE;
+}
+
+EntityStore::PoolStats EntityStore::poolStats(SpeciesIndex speciesIndex) const {
+    if (speciesIndex >= pools.size()) {
+        return {};
+    }
+    return {pools[speciesIndex].capacity, countOf(speciesIndex), pools[speciesIndex].highWater};
+}
+
+void EntityStore::removeMember(EntityId id) {
+    // Swap the last member of the species into the removed member's place
+    SpeciesIndex speciesIndex = speciesIndices[id];
+    std::vector<EntityId> &members = speciesMembers[speciesIndex];
+    EntityId lastMember = members.back();
+    members[memberPositions[id]] = lastMember;
+    memberPositions[lastMember] = memberPositions[id];
+    members.pop_back();
+    markMemberChanged(speciesIndex, memberPositions[id]);
+    markChanged(lastMember);
+}
+
+void EntityStore::reserve(const std::vector<size_t> &speciesCounts) {
+    size_t slotCount = flags.size();
+    for (size_t index = 0; index < speciesCounts.size(); index++) {
+        if (speciesCounts[index] == 0) {
+            continue;
+        }
+        if (speciesMembers.size() <= index) {
+            speciesMembers.resize(index + 1);
+            pools.resize(index + 1);
+        }
+        speciesMembers[index].reserve(speciesMembers[index].size() + speciesCounts[index]);
+        slotCount += (speciesCounts[index] + SLAB_SIZE - 1) / SLAB_SIZE * SLAB_SIZE;
+    }
+    locations.reserve(slotCount);
+    speciesIndices.reserve(slotCount);
+    energies.reserve(slotCount);
+    flags.reserve(slotCount);
+    nextFree.reserve(slotCount);
+    memberPositions.reserve(slotCount);
+}
+
+void EntityStore::setWorkerCount(int workerCount) {
+    changedIds.resize(workerCount);
+    changedMembers.resize(workerCount);
+    destroyedIds.resize(workerCount);
+}
+
+void EntityStore::clear() {
+    locations.clear();
+    speciesIndices.clear();
+    energies.clear();
+    flags.clear();
+    nextFree.clear();
+    speciesMembers.clear();
+    memberPositions.clear();
+    pools.clear();
+    livingCount = 0;
+    for (size_t worker = 0; worker < changedIds.size(); worker++) {
+        destroyedIds[worker].clear();
+        changedIds[worker].clear();
+        changedMembers[worker].clear();
+    }
+}
+
+void EntityStore::writeTo(BinaryWriter &writer) const {
+    writer.writeArray(locations);
+    writer.writeArray(speciesIndices);
+    writer.writeArray(energies);
+    writer.writeArray(flags);
+    writer.writeArray(nextFree);
+    writer.writeArray(memberPositions);
+    // Pools are written field by field so their padding never ends up in the file
+    writer.write((uint64_t) pools.size());
+    for (const SpeciesPool &pool: pools) {
+        writer.write((int32_t) pool.freeHead);
+        writer.write((uint64_t) pool.capacity);
+        writer.write((uint64_t) pool.highWater);
+    }
+    for (const std::vector<EntityId> &members: speciesMembers) {
+        writer.writeArray(members);
+    }
+    writer.write((uint64_t) livingCount);
+}
+
+bool EntityStore::readFrom(BinaryReader &reader) {
+    clear();
+    uint64_t savedLivingCount = 0;
+    uint64_t poolCount = 0;
+    bool readOk = reader.readArray(locations) && reader.readArray(speciesIndices) && reader.readArray(energies) &&
+                  reader.readArray(flags) && reader.readArray(nextFree) && reader.readArray(memberPositions) &&
+                  reader.read(poolCount) && poolCount <= SpeciesTable::MAX_SPECIES;
+    pools.resize(readOk ? poolCount : 0);
+    for (SpeciesPool &pool: pools) {
+        int32_t freeHead;
+        uint64_t capacity, highWater;
+        readOk = readOk && reader.read(freeHead) && reader.read(capacity) && reader.read(highWater);
+        pool = {freeHead, capacity, highWater};
+    }
+    speciesMembers.resize(pools.size());
+    for (std::vector<EntityId> &members: speciesMembers) {
+        readOk = readOk && reader.readArray(members);
+    }
+    readOk = readOk && reader.read(savedLivingCount);
+    livingCount = savedLivingCount;
+
+    // Every slot array must cover the same slots and every listed member must be a valid slot
+    size_t slotCount = flags.size();
+    readOk = readOk && locations.size() == slotCount && speciesIndices.size() == slotCount &&
+             energies.size() == slotCount && nextFree.size() == slotCount && memberPositions.size() == slotCount;
+    auto isSlotOrNone = [slotCount](EntityId id) { return id == NO_ENTITY || (id >= 0 && (size_t) id < slotCount); };
+    for (size_t id = 0; readOk && id < slotCount; id++) {
+        readOk = isSlotOrNone(nextFree[id]);
+    }
+
+    // Every free list only holds dead slots of its own species and visits each slot once, which also rules out
+    // cycles and lists that run into each other
+    std::vector<bool> onFreeList(readOk ? slotCount : 0, false);
+    for (size_t speciesIndex = 0; readOk && speciesIndex < pools.size(); speciesIndex++) {
+        EntityId id = pools[speciesIndex].freeHead;
+        readOk = isSlotOrNone(id);
+        for (; readOk && id != NO_ENTITY; id = nextFree[id]) {
+            readOk = !onFreeList[id] && !(flags[id] & ALIVE) && speciesIndices[id] == speciesIndex;
+            onFreeList[id] = true;
+        }
+    }
+
+    size_t aliveSlotCount = 0;
+    for (size_t id = 0; readOk && id < slotCount; id++) {
+        aliveSlotCount += (flags[id] & ALIVE) != 0;
+    }
+    readOk = readOk && aliveSlotCount == livingCount;
+    size_t memberCount = 0;
+    for (const std::vector<EntityId> &members: speciesMembers) {
+        for (size_t position = 0; readOk && position < members.size(); position++) {
+            EntityId id = members[position];
+            readOk = id >= 0 && (size_t) id < slotCount && memberPositions[id] == position;
+        }
+        memberCount += members.size();
+    }
+    readOk = readOk && memberCount == livingCount;
+    if (!readOk) {
+        clear();
+    }
+    return readOk;
+}
+
+void EntityStore::copyChangesFrom(const EntityStore &source) {
+    if (flags.size() < source.flags.size()) {
+        size_t slotCount = source.flags.size();
+        locations.resize(slotCount);
+        speciesIndices.resize(slotCount);
+        energies.resize(slotCount);
+        flags.resize(slotCount, 0);
+        nextFree.resize(slotCount, NO_ENTITY);
+        memberPositions.resize(slotCount, 0);
+    }
+
+    for (const auto &workerChangedIds: source.changedIds) {
+        for (EntityId id: workerChangedIds) {
+            locations[id] = source.locations[id];
+            speciesIndices[id] = source.speciesIndices[id];
+            energies[id] = source.energies[id];
+            flags[id] = source.flags[id];
+            nextFree[id] = source.nextFree[id];
+            memberPositions[id] = source.memberPositions[id];
+        }
+    }
+
+    // Lists take the source's lengths and only the positions written since the last clearChanges are copied
+    speciesMembers.resize(source.speciesMembers.size());
+    for (size_t speciesIndex = 0; speciesIndex < source.speciesMembers.size(); speciesIndex++) {
+        speciesMembers[speciesIndex].resize(source.speciesMembers[speciesIndex].size());
+    }
+    for (const auto &workerChangedMembers: source.changedMembers) {
+        for (const std::pair<SpeciesIndex, uint32_t> &member: workerChangedMembers) {
+            const std::vector<EntityId> &sourceMembers = source.speciesMembers[member.first];
+            if (member.second < sourceMembers.size()) {
+                speciesMembers[member.first][member.second] = sourceMembers[member.second];
+            }
+        }
+    }
+
+    pools = source.pools;
+    livingCount = source.livingCount;
+}
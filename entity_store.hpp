@@ -0,0 +1,249 @@
+#ifndef ECOSIM_ENTITY_STORE_HPP
+#define ECOSIM_ENTITY_STORE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "species_table.hpp"
+#include "thread_pool.hpp"
+#include "binary_io.hpp"
+
+using Point = std::pair<int, int>;
+using EntityId = int32_t;
+
+const EntityId NO_ENTITY = -1;
+// Placeholder for a cell claimed by a birth that is created when the phase is committed
+const EntityId RESERVED_ENTITY = -2;
+
+/**
+ * Structure-of-arrays storage for every plant and animal in the simulation. Each field lives in its own contiguous
+ * array indexed by EntityId, so a pass over one field streams through memory. Per-species constants are looked up
+ * in the SpeciesTable through the stored species index.
+ *
+ * The living elements of every species are also kept in a per-species member list, so a pass over one species never
+ * touches the others and population counts are O(1). Lists are only updated when elements are created or their
+ * slots released, and list order is arbitrary but the same from run to run.
+ *
+ * Slots are handed to species in slabs of SLAB_SIZE consecutive ids, and every species recycles the slots of its
+ * dead elements through its own free list. Elements of a species stay clustered in memory, and once a population
+ * has reached its high-water mark, births and deaths no longer grow any array.
+ *
+ * Every write records the id it touched, and every member list update the list position it wrote, so a second store
+ * can be brought up to date with copyChangesFrom in time proportional to the changes rather than the population.
+ * Changes and destructions are logged per pool worker, so workers may write to distinct elements concurrently.
+ * Creating elements and releasing slots must happen on a single thread
+ */
+class EntityStore {
+public:
+    /**
+     * Slot usage of one species' pool
+     */
+    struct PoolStats {
+        size_t capacity = 0;
+        size_t occupied = 0;
+        size_t highWater = 0;
+    };
+
+    /**
+     * Creates a new element, reusing a released slot of its species when one is available
+     * @param speciesIndex index of the element's species in the species table
+     * @param location point location of the element
+     * @param energy starting energy level
+     * @return id of the new element
+     */
+    EntityId create(SpeciesIndex speciesIndex, const Point &location, int energy);
+
+    /**
+     * Reserves room for a known number of new elements per species, so that creating them in bulk does not
+     * repeatedly grow the slot arrays and member lists
+     * @param speciesCounts number of elements about to be created for each species index
+     */
+    void reserve(const std::vector<size_t> &speciesCounts);
+
+    /**
+     * Marks the element as dead. The slot stays reserved until releaseDestroyed is called so that its id cannot be
+     * handed out again while other code may still refer to it
+     * @param id element to destroy
+     */
+    void destroy(EntityId id);
+
+    /**
+     * Returns the slots of every element destroyed since the last call to their species' free list. Slots are
+     * released in id order so the ids handed out afterwards do not depend on which worker destroyed what
+     */
+    void releaseDestroyed();
+
+    /**
+     * Sets the number of pool workers that may write to the store concurrently
+     * @param workerCount number of workers
+     */
+    void setWorkerCount(int workerCount);
+
+    /**
+     * Destroys every element and releases all slots
+     */
+    void clear();
+
+    /**
+     * Copies every slot and member list position the source store changed since its last clearChanges, along with
+     * the free list, so that this store ends up identical to the source
+     * @param source store to copy changes from
+     */
+    void copyChangesFrom(const EntityStore &source);
+
+    /**
+     * Visits every slot changed since the last clearChanges, including released and newly added slots. A slot may be
+     * visited more than once
+     * @param visitor callable taking an EntityId
+     */
+    template<typename Visitor>
+    void forEachChangedId(Visitor &&visitor) const {
+        for (const auto &workerChangedIds: changedIds) {
+            for (EntityId id: workerChangedIds) {
+                visitor(id);
+            }
+        }
+    }
+
+    void clearChanges() {
+        for (auto &workerChangedIds: changedIds) {
+            workerChangedIds.clear();
+        }
+        for (auto &workerChangedMembers: changedMembers) {
+            workerChangedMembers.clear();
+        }
+    }
+
+    /**
+     * Writes every slot, member list and pool of the store
+     * @param writer checkpoint being written
+     */
+    void writeTo(BinaryWriter &writer) const;
+
+    /**
+     * Replaces the contents of the store with what writeTo wrote. Change logs start out empty
+     * @param reader checkpoint being read
+     * @return false if the data could not be read or is inconsistent
+     */
+    bool readFrom(BinaryReader &reader);
+
+    /**
+     * Visits every living element in id order. Slots created during the pass are not visited
+     * @param visitor callable taking an EntityId
+     */
+    template<typename Visitor>
+    void forEachAlive(Visitor &&visitor) const {
+        auto slotCount = (EntityId) flags.size();
+        for (EntityId id = 0; id < slotCount; id++) {
+            if (flags[id] & ALIVE) {
+                visitor(id);
+            }
+        }
+    }
+
+    bool isAlive(EntityId id) const { return (size_t) id < flags.size() && (flags[id] & ALIVE) != 0; }
+
+    SpeciesIndex getSpecies(EntityId id) const { return speciesIndices[id]; }
+
+    Point getLocation(EntityId id) const { return locations[id]; }
+
+    void setLocation(EntityId id, const Point &location) {
+        locations[id] = location;
+        markChanged(id);
+    }
+
+    int getEnergy(EntityId id) const { return energies[id]; }
+
+    void setEnergy(EntityId id, int energy) {
+        energies[id] = energy;
+        markChanged(id);
+    }
+
+    bool isGrown(EntityId id) const { return (flags[id] & GROWN) != 0; }
+
+    void setGrown(EntityId id, bool isGrown) {
+        flags[id] = isGrown ? (uint8_t) (flags[id] | GROWN) : (uint8_t) (flags[id] & ~GROWN);
+        markChanged(id);
+    }
+
+    size_t slotCount() const { return flags.size(); }
+
+    /**
+     * Returns the living elements of a species as of the last commit
+     * @param speciesIndex index of the species in the species table
+     * @return ids of the species' elements in no particular order
+     */
+    const std::vector<EntityId> &membersOf(SpeciesIndex speciesIndex) const {
+        static const std::vector<EntityId> noMembers;
+        return speciesIndex < speciesMembers.size() ? speciesMembers[speciesIndex] : noMembers;
+    }
+
+    size_t countOf(SpeciesIndex speciesIndex) const { return membersOf(speciesIndex).size(); }
+
+    /**
+     * Returns the slot capacity, occupancy and highest occupancy so far of a species' pool
+     * @param speciesIndex index of the species in the species table
+     * @return pool statistics as of the last commit
+     */
+    PoolStats poolStats(SpeciesIndex speciesIndex) const;
+
+    static constexpr size_t SLAB_SIZE = 64;
+
+    /**
+     * Returns the number of living elements as of the last commit
+     * @return living element count
+     */
+    size_t aliveCount() const { return livingCount; }
+
+private:
+    void markChanged(EntityId id) { changedIds[ThreadPool::workerIndex()].push_back(id); }
+
+    void markMemberChanged(SpeciesIndex speciesIndex, uint32_t position) {
+        changedMembers[ThreadPool::workerIndex()].emplace_back(speciesIndex, position);
+    }
+
+    /**
+     * Appends a slab of free slots to a species' pool
+     * @param speciesIndex index of the species in the species table
+     */
+    void addSlab(SpeciesIndex speciesIndex);
+
+    /**
+     * Removes an element from its species' member list
+     * @param id element to remove
+     */
+    void removeMember(EntityId id);
+
+    enum Flags : uint8_t {
+        ALIVE = 1, GROWN = 2
+    };
+
+    std::vector<Point> locations;
+    std::vector<SpeciesIndex> speciesIndices;
+    std::vector<int> energies;
+    std::vector<uint8_t> flags;
+    // Free slots of each species form a linked list threaded through nextFree, so allocation never touches another
+    // container
+    std::vector<EntityId> nextFree;
+    // Living ids of every species, and the position of every id within its species' list
+    std::vector<std::vector<EntityId>> speciesMembers;
+    std::vector<uint32_t> memberPositions;
+
+    struct SpeciesPool {
+        EntityId freeHead = NO_ENTITY;
+        size_t capacity = 0;
+        size_t highWater = 0;
+    };
+    std::vector<SpeciesPool> pools;
+    size_t livingCount = 0;
+    std::vector<std::vector<EntityId>> destroyedIds = std::vector<std::vector<EntityId>>(1);
+    std::vector<std::vector<EntityId>> changedIds = std::vector<std::vector<EntityId>>(1);
+    // Species and list position of every member list entry written, lists that shrank are cut to size on copy
+    std::vector<std::vector<std::pair<SpeciesIndex, uint32_t>>> changedMembers =
+        std::vector<std::vector<std::pair<SpeciesIndex, uint32_t>>>(1);
+};
+
+#endif //ECOSIM_ENTITY_STORE_HPP
@@ -0,0 +1,84 @@
+#include "event_scheduler.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+void EventScheduler::commit() {
+    for (std::vector<ScheduledEvent> &workerEvents: stagedEvents) {
+        for (const ScheduledEvent &event: workerEvents) {
+            slots[event.dueTick % WHEEL_SIZE].push_back(event);
+        }
+        eventCount += workerEvents.size();
+        workerEvents.clear();
+    }
+}
+
+void EventScheduler::takeDue(long tick, std::vector<ScheduledEvent> &dueEvents) {
+    dueEvents.clear();
+    std::vector<ScheduledEvent> &slot = slots[tick % WHEEL_SIZE];
+
+    // Events of later revolutions stay behind in the slot
+    auto laterEvents = std::partition(slot.begin(), slot.end(), [tick](const ScheduledEvent &event) {
+        return event.dueTick == tick;
+    });
+    dueEvents.assign(slot.begin(), laterEvents);
+    slot.erase(slot.begin(), laterEvents);
+    eventCount -= dueEvents.size();
+
+    // Staging order depends on which worker scheduled what, so order the events before they are handed out
+    std::sort(dueEvents.begin(), dueEvents.end(), [](const ScheduledEvent &first, const ScheduledEvent &second) {
+        return first.type != second.type ? first.type < second.type : first.id < second.id;
+    });
+}
+
+void EventScheduler::writeTo(BinaryWriter &writer) const {
+    // Events are written field by field so their padding never ends up in the file, and sorted so the file does
+    // not depend on which worker staged which event
+    std::vector<ScheduledEvent> sortedSlot;
+    for (const std::vector<ScheduledEvent> &slot: slots) {
+        sortedSlot.assign(slot.begin(), slot.end());
+        std::sort(sortedSlot.begin(), sortedSlot.end(), [](const ScheduledEvent &first, const ScheduledEvent &second) {
+            return std::tie(first.dueTick, first.id, first.type) < std::tie(second.dueTick, second.id, second.type);
+        });
+        writer.write((uint64_t) sortedSlot.size());
+        for (const ScheduledEvent &event: sortedSlot) {
+            writer.write((int64_t) event.dueTick);
+            writer.write((int32_t) event.id);
+            writer.write((uint8_t) event.type);
+        }
+    }
+}
+
+bool EventScheduler::readFrom(BinaryReader &reader) {
+    clear();
+    bool readOk = true;
+    for (size_t slotIndex = 0; slotIndex < slots.size() && readOk; slotIndex++) {
+        // The count is checked against the bytes left before anything is allocated for it
+        uint64_t slotEventCount = 0;
+        readOk = reader.read(slotEventCount) && slotEventCount <= reader.bytesLeft() / SAVED_EVENT_BYTES;
+        slots[slotIndex].resize(readOk ? slotEventCount : 0);
+        for (ScheduledEvent &event: slots[slotIndex]) {
+            int64_t dueTick;
+            int32_t id;
+            uint8_t type;
+            readOk = readOk && reader.read(dueTick) && reader.read(id) && reader.read(type) && dueTick >= 0 &&
+                     (size_t) (dueTick % WHEEL_SIZE) == slotIndex && type == REGROWN_EVENT;
+            event = {(long) dueTick, id, (EventType) type};
+        }
+        eventCount += slots[slotIndex].size();
+    }
+    if (!readOk) {
+        clear();
+    }
+    return readOk;
+}
+
+void EventScheduler::clear() {
+    for (std::vector<ScheduledEvent> &slot: slots) {
+        slot.clear();
+    }
+    for (std::vector<ScheduledEvent> &workerEvents: stagedEvents) {
+        workerEvents.clear();
+    }
+    eventCount = 0;
+}
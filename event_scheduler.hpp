@@ -0,0 +1,100 @@
+#ifndef ECOSIM_EVENT_SCHEDULER_HPP
+#define ECOSIM_EVENT_SCHEDULER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "entity_store.hpp"
+#include "binary_io.hpp"
+
+/**
+ * Kinds of delayed events
+ */
+enum EventType : uint8_t {
+    REGROWN_EVENT
+};
+
+/**
+ * Event due for an element at a given tick
+ */
+struct ScheduledEvent {
+    long dueTick;
+    EntityId id;
+    EventType type;
+};
+
+/**
+ * Timing wheel of delayed events. Every tick maps to one of WHEEL_SIZE slots, so taking the events due at a tick
+ * only looks at the events that share its slot, and ticks with nothing due cost nothing. Events more than a full
+ * revolution ahead simply stay in their slot until the wheel comes round to their tick.
+ *
+ * Events scheduled during a phase are staged per pool worker and only enter the wheel once the phase is committed,
+ * so workers may schedule concurrently
+ */
+class EventScheduler {
+public:
+    /**
+     * Schedules an event. The event is staged until commit is called
+     * @param dueTick tick at which the event is due
+     * @param id element the event applies to
+     * @param type kind of event
+     */
+    void schedule(long dueTick, EntityId id, EventType type) {
+        stagedEvents[ThreadPool::workerIndex()].push_back({dueTick, id, type});
+    }
+
+    /**
+     * Moves every staged event into the wheel
+     */
+    void commit();
+
+    /**
+     * Removes the events due at the given tick from the wheel. Must be called for every tick in turn, events due at
+     * a tick that is skipped are never returned
+     * @param tick current tick
+     * @param dueEvents filled with the due events ordered by type and element id
+     */
+    void takeDue(long tick, std::vector<ScheduledEvent> &dueEvents);
+
+    /**
+     * Sets the number of pool workers that may schedule events concurrently
+     * @param workerCount number of workers
+     */
+    void setWorkerCount(int workerCount) { stagedEvents.resize(workerCount); }
+
+    /**
+     * Discards every scheduled and staged event
+     */
+    void clear();
+
+    /**
+     * Returns the number of events in the wheel, not counting staged ones
+     * @return scheduled event count
+     */
+    size_t scheduledCount() const { return eventCount; }
+
+    /**
+     * Writes every event in the wheel. Staged events are not written, so this is only called between phases
+     * @param writer checkpoint being written
+     */
+    void writeTo(BinaryWriter &writer) const;
+
+    /**
+     * Replaces the events in the wheel with what writeTo wrote
+     * @param reader checkpoint being read
+     * @return false if the data could not be read
+     */
+    bool readFrom(BinaryReader &reader);
+
+    static const int WHEEL_SIZE = 64;
+    // Bytes of the due tick, id and type every event is written as
+    static const size_t SAVED_EVENT_BYTES = sizeof(int64_t) + sizeof(int32_t) + sizeof(uint8_t);
+
+private:
+    std::vector<std::vector<ScheduledEvent>> slots = std::vector<std::vector<ScheduledEvent>>(WHEEL_SIZE);
+    std::vector<std::vector<ScheduledEvent>> stagedEvents = std::vector<std::vector<ScheduledEvent>>(1);
+    size_t eventCount = 0;
+};
+
+#endif //ECOSIM_EVENT_SCHEDULER_HPP
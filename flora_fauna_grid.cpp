@@ -0,0 +1,44 @@
+#include "flora_fauna_grid.hpp"
+
+void FloraFaunaGrid::reset(int rows, int columns) {
+    this->rows = rows;
+    this->columns = columns;
+    floraLayer.assign((size_t) rows * columns, NO_ENTITY);
+    faunaLayer.assign((size_t) rows * columns, NO_ENTITY);
+    clearChanges();
+}
+
+bool FloraFaunaGrid::rebuildFrom(const EntityStore &entities, const SpeciesTable &species) {
+    bool cellsDistinct = true;
+    for (size_t speciesIndex = 0; speciesIndex < species.size(); speciesIndex++) {
+        std::vector<EntityId> &layer =
+                species[(SpeciesIndex) speciesIndex].speciesType == SpeciesType::PLANT ? floraLayer : faunaLayer;
+        for (EntityId id: entities.membersOf((SpeciesIndex) speciesIndex)) {
+            EntityId &cell = layer[cellIndex(entities.getLocation(id))];
+            cellsDistinct &= cell == NO_ENTITY;
+            cell = cell == NO_ENTITY ? id : cell;
+        }
+    }
+    clearChanges();
+    return cellsDistinct;
+}
+
+void FloraFaunaGrid::moveFauna(const Point &from, const Point &to) {
+    size_t fromIndex = cellIndex(from);
+    size_t toIndex = cellIndex(to);
+    if (fromIndex != toIndex) {
+        faunaLayer[toIndex] = faunaLayer[fromIndex];
+        faunaLayer[fromIndex] = NO_ENTITY;
+        markChanged(fromIndex);
+        markChanged(toIndex);
+    }
+}
+
+void FloraFaunaGrid::copyChangesFrom(const FloraFaunaGrid &source) {
+    for (const auto &workerChangedCells: source.changedCells) {
+        for (size_t index: workerChangedCells) {
+            floraLayer[index] = source.floraLayer[index];
+            faunaLayer[index] = source.faunaLayer[index];
+        }
+    }
+}
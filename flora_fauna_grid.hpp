@@ -0,0 +1,136 @@
+#ifndef ECOSIM_FLORA_FAUNA_GRID_HPP
+#define ECOSIM_FLORA_FAUNA_GRID_HPP
+
+#include <vector>
+
+#include "entity_store.hpp"
+
+/**
+ * Dense row-major world store with one flora layer and one fauna layer. Each cell holds the id of at most one plant
+ * and at most one animal, which allows an animal to stand on top of a plant while every lookup stays O(1).
+ *
+ * Every write records the cell it touched so a second grid can be brought up to date with copyChangesFrom. Changes
+ * are logged per pool worker, so workers may write to distinct cells concurrently
+ */
+class FloraFaunaGrid {
+public:
+    /**
+     * Clears every cell and resizes the grid to the given dimensions
+     * @param rows number of rows in the map
+     * @param columns number of columns in the map
+     */
+    void reset(int rows, int columns);
+
+    void setFlora(const Point &location, EntityId id) {
+        size_t index = cellIndex(location);
+        floraLayer[index] = id;
+        markChanged(index);
+    }
+
+    void setFauna(const Point &location, EntityId id) {
+        size_t index = cellIndex(location);
+        faunaLayer[index] = id;
+        markChanged(index);
+    }
+
+    /**
+     * Moves the animal at one location to another, leaving any plant at either location in place
+     * @param from current location of the animal
+     * @param to new location for the animal
+     */
+    void moveFauna(const Point &from, const Point &to);
+
+    /**
+     * Places every living element of the store in its cell, plants on the flora layer and animals on the fauna
+     * layer. The grid must be empty, as it is after reset, and nothing is logged as changed
+     * @param entities store to take the elements from
+     * @param species species table the store's species indices refer to
+     * @return false if two elements of the same layer share a cell, the later one is not placed then
+     */
+    bool rebuildFrom(const EntityStore &entities, const SpeciesTable &species);
+
+    /**
+     * Copies every cell the source grid changed since its last clearChanges so that this grid ends up identical to
+     * the source. Both grids must have the same dimensions
+     * @param source grid to copy changes from
+     */
+    void copyChangesFrom(const FloraFaunaGrid &source);
+
+    /**
+     * Visits the index of every cell changed since the last clearChanges. A cell may be visited more than once
+     * @param visitor callable taking a row-major cell index
+     */
+    template<typename Visitor>
+    void forEachChangedCell(Visitor &&visitor) const {
+        for (const auto &workerChangedCells: changedCells) {
+            for (size_t index: workerChangedCells) {
+                visitor(index);
+            }
+        }
+    }
+
+    void clearChanges() {
+        for (auto &workerChangedCells: changedCells) {
+            workerChangedCells.clear();
+        }
+    }
+
+    /**
+     * Sets the number of pool workers that may write to the grid concurrently
+     * @param workerCount number of workers
+     */
+    void setWorkerCount(int workerCount) { changedCells.resize(workerCount); }
+
+    bool inBounds(const Point &location) const {
+        return location.first >= 0 && location.first < columns && location.second >= 0 && location.second < rows;
+    }
+
+    EntityId flora(const Point &location) const { return floraLayer[cellIndex(location)]; }
+
+    EntityId fauna(const Point &location) const { return faunaLayer[cellIndex(location)]; }
+
+    /**
+     * Returns the element that is visible at the location, preferring an animal standing on a plant
+     * @param location point location to check
+     * @return id of the visible element or NO_ENTITY if the cell is empty
+     */
+    EntityId topElement(const Point &location) const {
+        size_t index = cellIndex(location);
+        return faunaLayer[index] != NO_ENTITY ? faunaLayer[index] : floraLayer[index];
+    }
+
+    /**
+     * Visits every element in row-major order, visiting each cell's plant before the animal standing on it
+     * @param visitor callable taking an EntityId
+     */
+    template<typename Visitor>
+    void forEachElement(Visitor &&visitor) const {
+        for (size_t index = 0; index < floraLayer.size(); index++) {
+            if (floraLayer[index] != NO_ENTITY) {
+                visitor(floraLayer[index]);
+            }
+            if (faunaLayer[index] != NO_ENTITY) {
+                visitor(faunaLayer[index]);
+            }
+        }
+    }
+
+    int getRows() const { return rows; }
+
+    int getColumns() const { return columns; }
+
+private:
+    void markChanged(size_t index) { changedCells[ThreadPool::workerIndex()].push_back(index); }
+
+    size_t cellIndex(const Point &location) const {
+        return (size_t) location.second * columns + location.first;
+    }
+
+    int rows = 0;
+    int columns = 0;
+    std::vector<EntityId> floraLayer;
+    std::vector<EntityId> faunaLayer;
+    std::vector<std::vector<size_t>> changedCells = std::vector<std::vector<size_t>>(1);
+};
+
+#endif //ECOSIM_FLORA_FAUNA_GRID_HPP
@@ -1,52 +1,26 @@
 #ifndef ECOSIM_HERBIVORE_HPP
 #define ECOSIM_HERBIVORE_HPP
 
-#include <vector>
-#include "ncurses.h"
+#include "entity_store.hpp"
+#include "counter_rng.hpp"
 
-#include "ecosystem_element.hpp"
-#include "species_type.hpp"
-
-class Herbivore : public EcosystemElement {
+/**
+ * Behaviour for herbivore elements. Animal state lives in the entity store, so the behaviour is stateless
+ */
+class Herbivore {
 public:
-    explicit Herbivore(const char &characterID, const Point initialLocation, const std::vector<char> &foodChainList,
-                       const int maxEnergyPoints)
-            : charID(characterID),
-              cachedLocation(initialLocation),
-              maxEnergy(maxEnergyPoints),
-              currentEnergy(maxEnergyPoints),
-              foodChain(foodChainList.begin(), foodChainList.end()) {}
-
-    void tick() override;
-
-    void makeEaten() override;
-
-    NCURSES_COLOR_T getColorPair() const override { return Herbivore::colorPair; }
-
-    SpeciesType getSpeciesType() const override { return Herbivore::speciesType; }
-
-    Point getCachedLocation() const override { return this->cachedLocation; }
-
-    void setCachedLocation(const Point &location) override { this->cachedLocation = location; }
-
-    char getCharID() const override { return this->charID; }
-
-    int getCurrentEnergy() const override { return this->currentEnergy; }
-
-    void setCurrentEnergy(const int energyToSet) override { this->currentEnergy = energyToSet; }
-
-    int getMaxEnergy() const override { return this->maxEnergy; }
-
-    std::vector<char> getFoodChain() const override { return this->foodChain; }
-
-private:
-    const static NCURSES_COLOR_T colorPair = 4;
-    const static SpeciesType speciesType = SpeciesType::HERBIVORE;
-    Point cachedLocation;
-    const char charID;
-    std::vector<char> foodChain;
-    int currentEnergy;
-    int maxEnergy;
+    /**
+     * Runs one simulation step for the animal: eat when hungry, otherwise breed or wander
+     * @param id animal to tick
+     * @param rng generator keyed to this animal and tick
+     */
+    static void tick(EntityId id, CounterRng &rng);
+
+    /**
+     * Drains the energy of an animal that was eaten
+     * @param id animal that was eaten
+     */
+    static void makeEaten(EntityId id);
 };
 
 #endif //ECOSIM_HERBIVORE_HPP
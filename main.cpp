@@ -4,45 +4,342 @@
 //
 
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <algorithm>
 #include <chrono>
+#include <iomanip>
+#include <limits>
 #include <thread>
+#include <atomic>
 #include <map>
 #include <unordered_map>
 #include "ncurses.h"
 
 #include "sim_utilities.hpp"
 #include "map_manager.hpp"
+#include "tick_engine.hpp"
+#include "tick_stats.hpp"
+#include "checkpoint.hpp"
+#include "map_renderer.hpp"
+#include "triple_buffer.hpp"
+#include "trace_recorder.hpp"
+#include "population_recorder.hpp"
+#include "action_log.hpp"
+#include "ensemble_runner.hpp"
 #include "species_type.hpp"
-#include "ecosystem_element.hpp"
-#include "plant.hpp"
-#include "herbivore.hpp"
-#include "omnivore.hpp"
+#include "entity_store.hpp"
+#include "species_table.hpp"
 
 // Macro to disable ncurses for debugging purposes
 //#define CURSES_DISABLED
 
 using namespace std;
 
+/**
+ * Writes the per-tick instrumentation table to the file requested on the command line, if any
+ * @param options parsed command line options
+ */
+static void writeTickStats(const SimUtilities::SimOptions &options) {
+    if (options.tickStatsFilePath.empty()) {
+        return;
+    }
+    ofstream tickStatsFile(options.tickStatsFilePath);
+    if (!tickStatsFile.is_open()) {
+        cerr << "Unable to open file '" << options.tickStatsFilePath << "'" << endl;
+        return;
+    }
+    TickStats::printTable(tickStatsFile);
+    cout << "Tick statistics written to " << options.tickStatsFilePath << endl;
+}
+
+/**
+ * Writes the recorded trace to the file requested on the command line, if any
+ * @param options parsed command line options
+ */
+static void writeTrace(const SimUtilities::SimOptions &options) {
+    if (options.traceFilePath.empty()) {
+        return;
+    }
+    ofstream traceFile(options.traceFilePath);
+    if (!traceFile.is_open()) {
+        cerr << "Unable to open file '" << options.traceFilePath << "'" << endl;
+        return;
+    }
+    TraceRecorder::writeJson(traceFile);
+    cout << "Trace written to " << options.traceFilePath << endl;
+}
+
+/**
+ * Replays the action log requested on the command line, if any, onto the loaded world. Exits if the log cannot be
+ * replayed
+ * @param options parsed command line options
+ */
+static void replayActions(const SimUtilities::SimOptions &options) {
+    if (options.replayFilePath.empty()) {
+        return;
+    }
+    if (!ActionLog::openReplay(options.replayFilePath)) {
+        cerr << "Unable to replay '" << options.replayFilePath << "', it was not recorded on this map" << endl;
+        exit(-1);
+    }
+    auto startTime = chrono::steady_clock::now();
+    long targetTick = options.replayToTick >= 0 ? options.replayToTick : numeric_limits<long>::max();
+    // Keyframes all lie after the tick the log starts at, so a tick before the loaded world cannot be reached
+    bool beforeWorld = targetTick < TickEngine::getTickCount();
+    if (!ActionLog::replayTo(targetTick)) {
+        if (beforeWorld) {
+            cerr << "Unable to replay to tick " << targetTick << ", the loaded world is already at tick "
+                 << TickEngine::getTickCount() << ". Load an earlier map or checkpoint" << endl;
+        } else {
+            cerr << "Action log '" << options.replayFilePath << "' is corrupt at tick " << TickEngine::getTickCount()
+                 << endl;
+        }
+        exit(-1);
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - startTime;
+    if (options.replayToTick > TickEngine::getTickCount()) {
+        cout << "Action log ends before tick " << options.replayToTick << endl;
+    }
+    cout << "Replayed to tick " << TickEngine::getTickCount() << " in " << elapsed.count() << " seconds" << endl;
+    ActionLog::closeReplay();
+}
+
+/**
+ * Runs the ensemble requested on the command line: the given number of replicas of the loaded world with the loaded
+ * species and with every species override, seeded alike across variants. Exits if an override cannot be applied or a
+ * recorder is running
+ * @param options parsed command line options
+ */
+static void runEnsemble(const SimUtilities::SimOptions &options) {
+    vector<SpeciesTable> variants = {SpeciesTable()};
+    vector<string> variantNames = {"Loaded species"};
+    for (const string &speciesFilePath: options.ensembleSpeciesFilePaths) {
+        variants.push_back(SimUtilities::loadSpeciesList(speciesFilePath));
+        variantNames.push_back("Species from " + speciesFilePath);
+        if (!EnsembleRunner::canOverride(MapManager::species(), variants.back())) {
+            cerr << "Species in '" << speciesFilePath << "' change the type of a species on the map" << endl;
+            exit(-1);
+        }
+    }
+
+    vector<ReplicaSettings> replicas;
+    for (size_t variant = 0; variant < variants.size(); variant++) {
+        for (int replica = 0; replica < options.ensembleReplicas; replica++) {
+            replicas.push_back({options.seed + (uint64_t) replica, variant});
+        }
+    }
+
+    auto startTime = chrono::steady_clock::now();
+    vector<ReplicaResult> results = EnsembleRunner::run(World::current(), variants, replicas, options.headlessTicks,
+                                                        options.threadCount);
+    if (results.empty()) {
+        cerr << "Ensembles cannot run while an action log or population recording is running" << endl;
+        exit(-1);
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - startTime;
+    cout << "Ran " << replicas.size() << " replicas of " << options.headlessTicks << " ticks in " << fixed
+         << setprecision(3) << elapsed.count() << " seconds on " << options.threadCount << " threads" << endl;
+    EnsembleRunner::printSummary(cout, results, MapManager::species(), variantNames);
+}
+
+/**
+ * Finishes the action log requested on the command line, if any
+ * @param options parsed command line options
+ */
+static void finishActionLog(const SimUtilities::SimOptions &options) {
+    if (options.recordActionsFilePath.empty()) {
+        return;
+    }
+    if (ActionLog::stopRecording()) {
+        cout << "Action log written to " << options.recordActionsFilePath << endl;
+    } else {
+        cerr << "Unable to write action log '" << options.recordActionsFilePath << "'" << endl;
+    }
+}
+
+/**
+ * Finishes the population recording requested on the command line, if any, and exports it as CSV when requested
+ * @param options parsed command line options
+ */
+static void finishPopulationRecording(const SimUtilities::SimOptions &options) {
+    if (options.populationFilePath.empty()) {
+        return;
+    }
+    if (!PopulationRecorder::stop()) {
+        cerr << "Unable to write population recording '" << options.populationFilePath << "'" << endl;
+        return;
+    }
+    cout << "Population recording written to " << options.populationFilePath << endl;
+
+    if (options.populationCsvFilePath.empty()) {
+        return;
+    }
+    ofstream csvFile(options.populationCsvFilePath);
+    if (!csvFile.is_open()) {
+        cerr << "Unable to open file '" << options.populationCsvFilePath << "'" << endl;
+        return;
+    }
+    if (PopulationRecorder::exportCsv(options.populationFilePath, csvFile)) {
+        cout << "Population CSV written to " << options.populationCsvFilePath << endl;
+    } else {
+        cerr << "Unable to export population recording '" << options.populationFilePath << "'" << endl;
+    }
+}
+
+/**
+ * Writes a checkpoint of the final state to the file requested on the command line, if any
+ * @param options parsed command line options
+ */
+static void writeCheckpoint(const SimUtilities::SimOptions &options) {
+    if (options.saveCheckpointFilePath.empty()) {
+        return;
+    }
+    if (Checkpoint::save(options.saveCheckpointFilePath)) {
+        cout << "Checkpoint at tick " << TickEngine::getTickCount() << " written to "
+             << options.saveCheckpointFilePath << endl;
+    } else {
+        cerr << "Unable to write checkpoint '" << options.saveCheckpointFilePath << "'" << endl;
+    }
+}
+
+/**
+ * Decides from the filename whether a saved map is run-length encoded
+ * @param mapFilePath filepath the map is saved to
+ * @return true if the filename ends in .rle
+ */
+static bool isCompressedMapPath(const string &mapFilePath) {
+    const string COMPRESSED_EXTENSION = ".rle";
+    return mapFilePath.size() >= COMPRESSED_EXTENSION.size() &&
+           mapFilePath.compare(mapFilePath.size() - COMPRESSED_EXTENSION.size(), string::npos,
+                               COMPRESSED_EXTENSION) == 0;
+}
+
+/**
+ * Writes the final map to the file requested on the command line, if any
+ * @param options parsed command line options
+ */
+static void writeMap(const SimUtilities::SimOptions &options) {
+    if (options.saveMapFilePath.empty()) {
+        return;
+    }
+    if (MapManager::saveMapToFile(options.saveMapFilePath, isCompressedMapPath(options.saveMapFilePath))) {
+        cout << "Map saved to " << options.saveMapFilePath << endl;
+    } else {
+        cerr << "Unable to write map '" << options.saveMapFilePath << "'" << endl;
+    }
+}
+
+#ifndef CURSES_DISABLED
+
+/**
+ * Applies the view keys pressed since the last frame. Arrow keys scroll a quarter of the window and o switches
+ * between the map and the overview. The simulation thread picks up the new view with its next frame
+ * @param window window the keys are read from, in non-blocking mode
+ * @param viewport view to change
+ */
+static void handleViewKeys(WINDOW *window, Viewport &viewport) {
+    int rowStep = max(1, viewport.getRows() / 4);
+    int columnStep = max(1, viewport.getColumns() / 4);
+    for (int key = wgetch(window); key != ERR; key = wgetch(window)) {
+        switch (key) {
+            case KEY_UP:
+                viewport.scrollBy(-rowStep, 0);
+                break;
+            case KEY_DOWN:
+                viewport.scrollBy(rowStep, 0);
+                break;
+            case KEY_LEFT:
+                viewport.scrollBy(0, -columnStep);
+                break;
+            case KEY_RIGHT:
+                viewport.scrollBy(0, columnStep);
+                break;
+            case 'o':
+                viewport.toggleOverview();
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+#endif
+
 int main(int argc, char **argv) {
-    string mapFilePath, speciesFilePath;
-    unordered_map<char, SimUtilities::SpeciesTraits> speciesList;
+    SimUtilities::SimOptions options = SimUtilities::parseOptions(argc, argv);
+    if (!options.traceFilePath.empty()) {
+        TraceRecorder::setThreadName("main");
+        TraceRecorder::start();
+    }
 
-    // Get arguments and set default map and species files if none are specified
-    if (argc >= 3) {
-        mapFilePath = argv[1];
-        speciesFilePath = argv[2];
+    if (!options.resumeFilePath.empty()) {
+        // A checkpoint carries its own species, tick count and seed
+        if (!Checkpoint::restore(options.resumeFilePath)) {
+            cerr << "Unable to restore checkpoint '" << options.resumeFilePath << "'" << endl;
+            exit(-1);
+        }
+        cout << "Resumed a map with " << MapManager::mapRows() << " rows and " << MapManager::mapColumns()
+             << " columns at tick " << TickEngine::getTickCount() << endl;
     } else {
-        mapFilePath = "default_input/map.txt";
-        speciesFilePath = "default_input/species.txt";
+        SpeciesTable speciesList;
+
+        // Load species list
+        speciesList = SimUtilities::loadSpeciesList(options.speciesFilePath);
+
+        // Load map into memory
+        SimUtilities::loadMap(options.mapFilePath, speciesList, options.threadCount);
+        TickEngine::setSeed(options.seed);
     }
 
-    // Load species list
-    speciesList = SimUtilities::loadSpeciesList(speciesFilePath);
+    TickEngine::setThreadCount(options.threadCount);
+    replayActions(options);
+    cout << "Using seed " << TickEngine::getSeed() << endl;
+
+    if (options.scalingReportTicks > 0) {
+        TickEngine::printScalingReport(options.scalingReportTicks, options.threadCount, cout);
+        writeTrace(options);
+        return 0;
+    }
+
+    if (options.ensembleReplicas > 0) {
+        runEnsemble(options);
+        writeTrace(options);
+        return 0;
+    }
+
+    TickStats::setRecording(!options.tickStatsFilePath.empty());
+    if (!options.populationFilePath.empty() && !PopulationRecorder::start(options.populationFilePath)) {
+        cerr << "Unable to open file '" << options.populationFilePath << "'" << endl;
+        exit(-1);
+    }
+    long keyframeInterval =
+        options.keyframeInterval >= 0 ? options.keyframeInterval : ActionLog::DEFAULT_KEYFRAME_INTERVAL;
+    if (!options.recordActionsFilePath.empty() &&
+        !ActionLog::startRecording(options.recordActionsFilePath, keyframeInterval)) {
+        cerr << "Unable to open file '" << options.recordActionsFilePath << "'" << endl;
+        exit(-1);
+    }
 
-    // Load map into memory
-    SimUtilities::loadMap(mapFilePath, speciesList);
+    if (options.headless) {
+        // Batch mode runs at full speed without touching the terminal
+        auto startTime = chrono::steady_clock::now();
+        for (int tickNum = 0; tickNum < options.headlessTicks; tickNum++) {
+            TickEngine::runTick();
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - startTime;
+        SimUtilities::printRunSummary(cout, options.headlessTicks, elapsed.count());
+        if (TickEngine::getThreadCount() > 1) {
+            TickEngine::printSchedulerStats(cout);
+        }
+        finishActionLog(options);
+        finishPopulationRecording(options);
+        writeTickStats(options);
+        writeCheckpoint(options);
+        writeMap(options);
+        writeTrace(options);
+        return 0;
+    }
 
     //region Curses setup
 #ifndef CURSES_DISABLED
@@ -52,9 +349,6 @@ int main(int argc, char **argv) {
     // Set the simulation window to take up 70% of the remaining space below the banner
     const int SIM_WINDOW_HEIGHT = (int) round((LINES - BANNER_HEIGHT) * 0.7f);
     const int COMMAND_WINDOW_HEIGHT = LINES - BANNER_HEIGHT - SIM_WINDOW_HEIGHT;
-    // Offset to add for centering the map in the console
-    const int MAP_OFFSET_Y = (SIM_WINDOW_HEIGHT - MapManager::mapRows) / 2;
-    const int MAP_OFFSET_X = (COLS - MapManager::mapColumns) / 2;
 
     auto topBanner = SimUtilities::createWindow(BANNER_HEIGHT, COLS, 0, 0, false);
     auto simulationWindow = SimUtilities::createWindow(SIM_WINDOW_HEIGHT, COLS, BANNER_HEIGHT, 0, true);
@@ -116,7 +410,16 @@ int main(int argc, char **argv) {
     wrefresh(topBanner);
     //endregion
 
-    SimUtilities::drawMap(simulationWindow, MAP_OFFSET_Y, MAP_OFFSET_X, true);
+    // Maps larger than the window are scrolled, the border takes one character on every side
+    Viewport viewport(SIM_WINDOW_HEIGHT - 2, COLS - 2);
+    FrameCapture frameCapture(viewport);
+    TripleBuffer<MapFrame> frames;
+    MapRenderer mapRenderer;
+    frameCapture.capture(frames.backBuffer());
+    frames.publish();
+    frames.consume();
+    mapRenderer.draw(simulationWindow, frames.frontBuffer(), true);
+    const auto FRAME_INTERVAL = chrono::microseconds(1000000 / options.framesPerSecond);
 #endif
 
     //region Main simulation tick loop
@@ -126,47 +429,53 @@ int main(int argc, char **argv) {
 #ifndef CURSES_DISABLED
         // Prompt user for number of simulation loops to run
         tickCount = SimUtilities::windowPromptInt(commandWindow, "Enter the number of simulation loops to run: ", 10);
-        SimUtilities::windowPrintString(commandWindow, "Running Simulation", true);
+        SimUtilities::windowPrintString(commandWindow,
+                                        "Running Simulation (arrow keys scroll the map, o toggles the overview)", true);
 #else
         tickCount = 20;
 #endif
 
-        // Run the simulation for the defined number of steps
-        for (int tickNum = 0; tickNum < tickCount; tickNum++) {
-            for (auto &element: MapManager::floraFauna) {
-                if (element.second->getSpeciesType() == SpeciesType::PLANT) {
-                    element.second->tick();
-                }
-            }
-
-            for (auto &element: MapManager::floraFauna) {
-                if (element.second->getSpeciesType() == SpeciesType::HERBIVORE) {
-                    // Check if energy levels are depleted
-                    if (element.second->getCurrentEnergy() <= 0) {
-                        MapManager::killElement(*element.second);
-                    } else {
-                        element.second->tick();
-                    }
+#ifndef CURSES_DISABLED
+        // The simulation runs on its own thread and publishes a frame after every tick. This thread draws the newest
+        // frame at the requested rate, frames published in between are dropped
+        cbreak();
+        noecho();
+        keypad(simulationWindow, TRUE);
+        nodelay(simulationWindow, TRUE);
+        atomic<bool> simulationDone(false);
+        thread simulationThread([&]() {
+            TraceRecorder::setThreadName("simulation");
+            for (int tickNum = 0; tickNum < tickCount; tickNum++) {
+                TickEngine::runTick();
+                frameCapture.capture(frames.backBuffer());
+                frames.publish();
+                if (options.tickDelayMillis > 0) {
+                    this_thread::sleep_for(chrono::milliseconds(options.tickDelayMillis));
                 }
             }
-
-            for (auto &element: MapManager::floraFauna) {
-                if (element.second->getSpeciesType() == SpeciesType::OMNIVORE) {
-                    // Check if energy levels are depleted
-                    if (element.second->getCurrentEnergy() <= 0) {
-                        MapManager::killElement(*element.second);
-                    } else {
-                        element.second->tick();
-                    }
-                }
+            simulationDone = true;
+        });
+        while (!simulationDone) {
+            auto frameStart = chrono::steady_clock::now();
+            handleViewKeys(simulationWindow, viewport);
+            if (frames.consume()) {
+                mapRenderer.draw(simulationWindow, frames.frontBuffer(), true);
             }
-
-#ifndef CURSES_DISABLED
-            SimUtilities::drawMap(simulationWindow, MAP_OFFSET_Y, MAP_OFFSET_X, true);
-#endif
-            // Sleep to allow the user to see the result of each simulation cycle
-            this_thread::sleep_for(chrono::milliseconds(500));
+            this_thread::sleep_until(frameStart + FRAME_INTERVAL);
         }
+        simulationThread.join();
+        if (frames.consume()) {
+            mapRenderer.draw(simulationWindow, frames.frontBuffer(), true);
+        }
+        nodelay(simulationWindow, FALSE);
+        echo();
+        nocbreak();
+#else
+        // Run the simulation for the defined number of steps
+        for (int tickNum = 0; tickNum < tickCount; tickNum++) {
+            TickEngine::runTick();
+        }
+#endif
 
 #ifndef CURSES_DISABLED
         vector<string> allowedValues = {"y", "n"};
@@ -184,7 +493,7 @@ int main(int argc, char **argv) {
                 string saveFileName = SimUtilities::windowPromptStr(commandWindow,
                                                                     "Enter a filename to save the map: ",
                                                                     allowedValues, true);
-                if (!MapManager::saveMapToFile(saveFileName)) {
+                if (!MapManager::saveMapToFile(saveFileName, isCompressedMapPath(saveFileName))) {
                     SimUtilities::windowPrintString(commandWindow, "An error occurred while saving the map. Exiting...",
                                                     true);
                     this_thread::sleep_for(chrono::milliseconds(2000));
@@ -208,6 +517,16 @@ int main(int argc, char **argv) {
     endwin();
 #endif
 
+    if (TickEngine::getThreadCount() > 1) {
+        TickEngine::printSchedulerStats(cout);
+    }
+
+    finishActionLog(options);
+    finishPopulationRecording(options);
+    writeTickStats(options);
+    writeCheckpoint(options);
+    writeMap(options);
+    writeTrace(options);
     cout << "Simulation complete" << endl;
     return 0;
 }
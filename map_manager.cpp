@@ -4,110 +4,93 @@
 #include <fstream>
 #include <algorithm>
 
+#include "plant.hpp"
+#include "herbivore.hpp"
+#include "omnivore.hpp"
+#include "action_log.hpp"
+#include "population_recorder.hpp"
+#include "tick_stats.hpp"
+#include "run_length_codec.hpp"
+#include "trace_recorder.hpp"
+
+// Bytes saveMapToFile gathers before each write
+static const size_t MAP_WRITE_BUFFER_SIZE = 1 << 22;
+
+NeighborCells MapManager::edibleFloraFaunaNearby(EntityId id) {
+    TickStats::countEvent(NEIGHBOR_QUERY_EVENT);
+    NeighborCells edibleLocations;
+    Point location(MapManager::entities().getLocation(id));
+    SpeciesIndex eaterSpecies = MapManager::entities().getSpecies(id);
+
+    Point cardinalPoints[4] = {Point(location.first, location.second - 1), Point(location.first, location.second + 1),
+                               Point(location.first + 1, location.second), Point(location.first - 1, location.second)};
+
+    for (const Point &pointToCheck: cardinalPoints) {
+        if (!MapManager::floraFauna().inBounds(pointToCheck)) {
+            continue;
+        }
+        EntityId foundFlora = MapManager::floraFauna().flora(pointToCheck);
+        EntityId foundFauna = MapManager::floraFauna().fauna(pointToCheck);
+
+        // Only cells holding a single element are edible, an animal standing on a plant shields it
+        if ((foundFlora == NO_ENTITY) == (foundFauna == NO_ENTITY)) {
+            continue;
+        }
 
-FloraFaunaList MapManager::floraFauna = {};
-WaterObstacleList MapManager::terrain = {};
-int MapManager::mapRows = 0;
-int MapManager::mapColumns = 0;
-
-vector<Point> MapManager::edibleFloraFaunaNearby(const EcosystemElement &element) {
-    vector<Point> edibleLocations;
-    Point location(element.getCachedLocation());
-    vector<char> foodChain = element.getFoodChain();
-
-    vector<Point> cardinalPoints = {Point(location.first, location.second - 1),
-                                    Point(location.first, location.second + 1),
-                                    Point(location.first + 1, location.second),
-                                    Point(location.first - 1, location.second)};
-
-    for (Point &pointToCheck: cardinalPoints) {
-        auto foundElements = MapManager::floraFauna.equal_range(pointToCheck);
-        int numFoundElements = distance(foundElements.first, foundElements.second);
-
-        if (numFoundElements == 1) {
-            if (find(foodChain.begin(), foodChain.end(), foundElements.first->second->getCharID()) != foodChain.end()) {
-                if (foundElements.first->second->getSpeciesType() == SpeciesType::PLANT) {
-                    // Only add fully grown plants to the edible locations
-                    if (foundElements.first->second->getIsGrown() == true) {
-                        edibleLocations.push_back(pointToCheck);
-                    }
-                } else {
-                    edibleLocations.push_back(pointToCheck);
-                }
+        if (foundFlora != NO_ENTITY) {
+            // Only add fully grown plants to the edible locations
+            if (MapManager::species().canEat(eaterSpecies, MapManager::entities().getSpecies(foundFlora)) &&
+                MapManager::entities().isGrown(foundFlora)) {
+                edibleLocations.add(pointToCheck);
             }
+        } else if (MapManager::species().canEat(eaterSpecies, MapManager::entities().getSpecies(foundFauna))) {
+            edibleLocations.add(pointToCheck);
         }
     }
 
     return edibleLocations;
 }
 
-vector<Point> MapManager::freeLocations(const EcosystemElement &element) {
-    vector<Point> availableLocations;
-    Point location(element.getCachedLocation());
-
-    Point north(location.first, location.second - 1);
-    Point south(location.first, location.second + 1);
-    Point east(location.first + 1, location.second);
-    Point west(location.first - 1, location.second);
-
-    if (north.second >= 0) {
-        auto northIterFloraFauna = MapManager::floraFauna.find(north);
-        auto northIterTerrain = MapManager::terrain.find(north);
-        if ((northIterFloraFauna == MapManager::floraFauna.end() ||
-             northIterFloraFauna->second->getSpeciesType() == SpeciesType::PLANT) &&
-            northIterTerrain == MapManager::terrain.end()) {
-            availableLocations.push_back(north);
-        }
-    }
-
-    if (south.second < MapManager::mapRows) {
-        auto southIterFloraFauna = MapManager::floraFauna.find(south);
-        auto southIterTerrain = MapManager::terrain.find(south);
-        if ((southIterFloraFauna == MapManager::floraFauna.end() ||
-             southIterFloraFauna->second->getSpeciesType() == SpeciesType::PLANT) &&
-            southIterTerrain == MapManager::terrain.end()) {
-            availableLocations.push_back(south);
-        }
-    }
+NeighborCells MapManager::freeLocations(EntityId id) {
+    TickStats::countEvent(NEIGHBOR_QUERY_EVENT);
+    NeighborCells availableLocations;
+    Point location(MapManager::entities().getLocation(id));
 
-    if (east.first < MapManager::mapColumns) {
-        auto eastIterFloraFauna = MapManager::floraFauna.find(east);
-        auto eastIterTerrain = MapManager::terrain.find(east);
-        if ((eastIterFloraFauna == MapManager::floraFauna.end() ||
-             eastIterFloraFauna->second->getSpeciesType() == SpeciesType::PLANT) &&
-            eastIterTerrain == MapManager::terrain.end()) {
-            availableLocations.push_back(east);
-        }
-    }
+    Point cardinalPoints[4] = {Point(location.first, location.second - 1), Point(location.first, location.second + 1),
+                               Point(location.first + 1, location.second), Point(location.first - 1, location.second)};
 
-    if (west.first >= 0) {
-        auto westIterFloraFauna = MapManager::floraFauna.find(west);
-        auto westIterTerrain = MapManager::terrain.find(west);
-        if ((westIterFloraFauna == MapManager::floraFauna.end() ||
-             westIterFloraFauna->second->getSpeciesType() == SpeciesType::PLANT) &&
-            westIterTerrain == MapManager::terrain.end()) {
-            availableLocations.push_back(west);
+    for (const Point &pointToCheck: cardinalPoints) {
+        // Plants can be walked over, other animals and terrain cannot
+        if (MapManager::floraFauna().inBounds(pointToCheck) &&
+            MapManager::floraFauna().fauna(pointToCheck) == NO_ENTITY &&
+            MapManager::terrain().isPassable(pointToCheck)) {
+            availableLocations.add(pointToCheck);
         }
     }
 
     return availableLocations;
 }
 
-vector<Point> MapManager::nearbyMates(const EcosystemElement &element) {
-    vector<Point> matesNearby;
-    Point location(element.getCachedLocation());
-
-    vector<Point> cardinalPoints = {Point(location.first, location.second - 1),
-                                    Point(location.first, location.second + 1),
-                                    Point(location.first + 1, location.second),
-                                    Point(location.first - 1, location.second)};
-
-    for (Point &pointToCheck: cardinalPoints) {
-        auto foundElementIter = MapManager::floraFauna.find(pointToCheck);
-        if (foundElementIter != MapManager::floraFauna.end()) {
-            if (foundElementIter->second->getCharID() == element.getCharID() &&
-                foundElementIter->second->getCurrentEnergy() > (0.5 * foundElementIter->second->getMaxEnergy())) {
-                matesNearby.push_back(pointToCheck);
+NeighborCells MapManager::nearbyMates(EntityId id) {
+    TickStats::countEvent(NEIGHBOR_QUERY_EVENT);
+    NeighborCells matesNearby;
+    Point location(MapManager::entities().getLocation(id));
+    SpeciesIndex mateSpecies = MapManager::entities().getSpecies(id);
+    // Mates need more than half of the species' maximum energy
+    double mateEnergyThreshold = 0.5 * MapManager::species()[mateSpecies].energy;
+
+    Point cardinalPoints[4] = {Point(location.first, location.second - 1), Point(location.first, location.second + 1),
+                               Point(location.first + 1, location.second), Point(location.first - 1, location.second)};
+
+    for (const Point &pointToCheck: cardinalPoints) {
+        if (!MapManager::floraFauna().inBounds(pointToCheck)) {
+            continue;
+        }
+        EntityId foundElement = MapManager::floraFauna().fauna(pointToCheck);
+        if (foundElement != NO_ENTITY) {
+            if (MapManager::entities().getSpecies(foundElement) == mateSpecies &&
+                MapManager::entities().getEnergy(foundElement) > mateEnergyThreshold) {
+                matesNearby.add(pointToCheck);
             }
         }
     }
@@ -115,99 +98,249 @@ vector<Point> MapManager::nearbyMates(const EcosystemElement &element) {
     return matesNearby;
 }
 
-void MapManager::moveElement(EcosystemElement &elementToMove, const Point &newLocation) {
-    // Extract the element(s) at the old location
-    auto foundElements = MapManager::floraFauna.equal_range(elementToMove.getCachedLocation());
-
-    // Scan through the elements
-    for (auto elementsIter = foundElements.first; elementsIter != foundElements.second; ++elementsIter) {
-        // If the element is not a plant (ie. if an herbivore is in the same location after eating the plant) then
-        // move the element to the new location
-        if (elementsIter->second->getSpeciesType() != SpeciesType::PLANT) {
-            auto nodeHandler = MapManager::floraFauna.extract(elementsIter);
-            nodeHandler.key() = newLocation;
-            MapManager::floraFauna.insert(move(nodeHandler));
-            break;
-        }
+bool MapManager::moveElement(EntityId id, const Point &newLocation) {
+    if (!MapManager::relocateElement(id, newLocation)) {
+        return false;
+    }
+    ActionLog::recordMove(id, newLocation);
+    return true;
+}
+
+bool MapManager::relocateElement(EntityId id, const Point &newLocation) {
+    Point oldLocation = MapManager::nextEntities().getLocation(id);
+    EntityId occupant = MapManager::nextFloraFauna().fauna(newLocation);
+    if (occupant != NO_ENTITY && occupant != id) {
+        return false;
     }
 
+    // Only the fauna layer moves, a plant under the animal stays where it is
+    MapManager::nextFloraFauna().moveFauna(oldLocation, newLocation);
+
     // Update the cached location of the element
-    elementToMove.setCachedLocation(newLocation);
+    MapManager::nextEntities().setLocation(id, newLocation);
 
     // Decrease the energy level by 1
-    elementToMove.setCurrentEnergy(elementToMove.getCurrentEnergy() - 1);
+    MapManager::setEnergy(id, MapManager::nextEntities().getEnergy(id) - 1);
+    TickStats::countEvent(MOVE_EVENT);
+    return true;
 }
 
-void MapManager::eatElement(EcosystemElement &elementEating, const Point &locationToEat) {
-    // Find element at the location
-    auto elementToEatIter = MapManager::floraFauna.find(locationToEat);
+bool MapManager::eatElement(EntityId eaterId, const Point &locationToEat) {
+    // Find the element at the location, an animal takes precedence over the plant beneath it
+    EntityId elementToEat = MapManager::floraFauna().topElement(locationToEat);
+    if (elementToEat == NO_ENTITY) {
+        return false;
+    }
 
-    // If the element exists, eat it
-    if (elementToEatIter != MapManager::floraFauna.end()) {
-        int energyToAdd = elementToEatIter->second->getCurrentEnergy();
-        elementToEatIter->second->makeEaten();
+    // The food must still be there in the pending state, untouched by anything earlier in the phase
+    if (MapManager::speciesOf(elementToEat).speciesType == SpeciesType::PLANT) {
+        if (!MapManager::nextEntities().isGrown(elementToEat) ||
+            MapManager::nextFloraFauna().fauna(locationToEat) != NO_ENTITY) {
+            return false;
+        }
+    } else if (!MapManager::nextEntities().isAlive(elementToEat) ||
+               MapManager::nextFloraFauna().fauna(locationToEat) != elementToEat) {
+        return false;
+    }
 
-        // Move to the new location
-        MapManager::moveElement(elementEating, locationToEat);
+    int energyToAdd = MapManager::entities().getEnergy(elementToEat);
+    switch (MapManager::speciesOf(elementToEat).speciesType) {
+        case PLANT:
+            Plant::makeEaten(elementToEat);
+            break;
+        case HERBIVORE:
+            Herbivore::makeEaten(elementToEat);
+            // Eaten animals are removed right away since the eater takes over their cell on the fauna layer
+            MapManager::removeElement(elementToEat);
+            break;
+        case OMNIVORE:
+            Omnivore::makeEaten(elementToEat);
+            MapManager::removeElement(elementToEat);
+            break;
+        default:
+            break;
+    }
+
+    // Move to the new location
+    MapManager::relocateElement(eaterId, locationToEat);
 
-        // Update energy level of element doing the eating
-        elementEating.setCurrentEnergy(
-                min(elementEating.getCurrentEnergy() + energyToAdd, elementEating.getMaxEnergy()));
+    // Update energy level of element doing the eating
+    MapManager::setEnergy(eaterId, min(MapManager::nextEntities().getEnergy(eaterId) + energyToAdd,
+                                       MapManager::speciesOf(eaterId).energy));
+    TickStats::countEvent(EAT_EVENT);
+    ActionLog::recordEat(eaterId, locationToEat);
+    return true;
+}
+
+void MapManager::setEnergy(EntityId id, int energy) {
+    EntityStore &nextEntities = MapManager::nextEntities();
+    PopulationRecorder::countEnergyChange(nextEntities.getSpecies(id), (int64_t) energy - nextEntities.getEnergy(id));
+    nextEntities.setEnergy(id, energy);
+}
+
+void MapManager::killElement(EntityId id) {
+    if (MapManager::speciesOf(id).speciesType != SpeciesType::PLANT) {
+        ActionLog::recordKill(id);
     }
+    MapManager::removeElement(id);
 }
 
-void MapManager::killElement(EcosystemElement &element) {
-    // Extract the element(s) at the location
-    auto foundElements = MapManager::floraFauna.equal_range(element.getCachedLocation());
+void MapManager::removeElement(EntityId id) {
+    if (MapManager::speciesOf(id).speciesType != SpeciesType::PLANT) {
+        MapManager::nextFloraFauna().setFauna(MapManager::nextEntities().getLocation(id), NO_ENTITY);
+        MapManager::nextEntities().destroy(id);
+        TickStats::countEvent(DEATH_EVENT);
+        SpeciesIndex speciesIndex = MapManager::nextEntities().getSpecies(id);
+        PopulationRecorder::countEvent(DEATH_COUNT, speciesIndex);
+        PopulationRecorder::countEnergyChange(speciesIndex, -(int64_t) MapManager::nextEntities().getEnergy(id));
+    }
+}
 
-    // Scan through the elements
-    for (auto elementsIter = foundElements.first; elementsIter != foundElements.second; ++elementsIter) {
-        // If the element is not a plant (ie. if an herbivore is in the same location after eating the plant) then
-        // go ahead and kill the element
-        if (elementsIter->second->getSpeciesType() != SpeciesType::PLANT) {
-            MapManager::floraFauna.erase(elementsIter);
-            break;
-        }
+EntityId MapManager::spawnElement(SpeciesIndex speciesIndex, const Point &location) {
+    const Species &newSpecies = MapManager::species()[speciesIndex];
+    bool isPlant = newSpecies.speciesType == SpeciesType::PLANT;
+    if ((isPlant ? MapManager::nextFloraFauna().flora(location) : MapManager::nextFloraFauna().fauna(location)) !=
+        NO_ENTITY) {
+        return NO_ENTITY;
     }
+
+    EntityId id = MapManager::nextEntities().create(speciesIndex, location, newSpecies.energy);
+    PopulationRecorder::countEnergyChange(speciesIndex, newSpecies.energy);
+    if (isPlant) {
+        MapManager::nextFloraFauna().setFlora(location, id);
+    } else {
+        MapManager::nextFloraFauna().setFauna(location, id);
+    }
+
+    return id;
 }
 
-bool MapManager::saveMapToFile(const string &filePath) {
-    vector<string> mapLines;
-    Point currentLocation;
-    ofstream mapFileStream(filePath);
-    bool isFirstLineWritten = false;
+bool MapManager::queueBirth(SpeciesIndex speciesIndex, const Point &location) {
+    if (MapManager::nextFloraFauna().fauna(location) != NO_ENTITY) {
+        return false;
+    }
+
+    MapManager::nextFloraFauna().setFauna(location, RESERVED_ENTITY);
+    MapManager::pendingBirths()[ThreadPool::workerIndex()].push_back({location, speciesIndex});
+    TickStats::countEvent(BIRTH_EVENT);
+    PopulationRecorder::countEvent(BIRTH_COUNT, speciesIndex);
+    ActionLog::recordBirth(speciesIndex, location);
+    return true;
+}
+
+void MapManager::swapBuffers() {
+    ActionLog::endPhase();
+
+    // Gather every worker's births and create them in row-major order of their cells
+    vector<pair<Point, SpeciesIndex>> &births = MapManager::pendingBirths()[0];
+    for (size_t worker = 1; worker < MapManager::pendingBirths().size(); worker++) {
+        vector<pair<Point, SpeciesIndex>> &workerBirths = MapManager::pendingBirths()[worker];
+        births.insert(births.end(), workerBirths.begin(), workerBirths.end());
+        workerBirths.clear();
+    }
+    sort(births.begin(), births.end(), [](const pair<Point, SpeciesIndex> &first,
+                                           const pair<Point, SpeciesIndex> &second) {
+        return make_pair(first.first.second, first.first.first) < make_pair(second.first.second, second.first.first);
+    });
+    for (auto &birth: births) {
+        int energy = MapManager::species()[birth.second].energy;
+        EntityId id = MapManager::nextEntities().create(birth.second, birth.first, energy);
+        PopulationRecorder::countEnergyChange(birth.second, energy);
+        MapManager::nextFloraFauna().setFauna(birth.first, id);
+    }
+    births.clear();
+
+    MapManager::events().commit();
+
+    // Slots of elements that died this phase only become reusable once nothing refers to them anymore
+    MapManager::nextEntities().releaseDestroyed();
 
+    swap(MapManager::floraFauna(), MapManager::nextFloraFauna());
+    swap(MapManager::entities(), MapManager::nextEntities());
+
+    if (MapManager::trackChangedCells()) {
+        // Besides cells that changed occupants, plants that were eaten or regrew change how their cell looks
+        MapManager::floraFauna().forEachChangedCell([](size_t index) { MapManager::changedCells().push_back(index); });
+        MapManager::entities().forEachChangedId([](EntityId id) {
+            const Point &location = MapManager::entities().getLocation(id);
+            if (MapManager::floraFauna().inBounds(location)) {
+                MapManager::changedCells().push_back((size_t) location.second * MapManager::mapColumns() +
+                                                     location.first);
+            }
+        });
+    }
+
+    MapManager::nextFloraFauna().copyChangesFrom(MapManager::floraFauna());
+    MapManager::nextEntities().copyChangesFrom(MapManager::entities());
+    MapManager::floraFauna().clearChanges();
+    MapManager::entities().clearChanges();
+}
+
+void MapManager::setWorkerCount(int workerCount) {
+    MapManager::floraFauna().setWorkerCount(workerCount);
+    MapManager::nextFloraFauna().setWorkerCount(workerCount);
+    MapManager::entities().setWorkerCount(workerCount);
+    MapManager::nextEntities().setWorkerCount(workerCount);
+    MapManager::pendingBirths().resize(workerCount);
+    MapManager::events().setWorkerCount(workerCount);
+}
+
+void MapManager::resetWorld(int rows, int columns) {
+    MapManager::mapRows() = rows;
+    MapManager::mapColumns() = columns;
+    MapManager::floraFauna().reset(rows, columns);
+    MapManager::nextFloraFauna().reset(rows, columns);
+    MapManager::terrain().reset(rows, columns);
+    MapManager::entities().clear();
+    MapManager::nextEntities().clear();
+    MapManager::events().clear();
+    MapManager::changedCells().clear();
+    for (auto &workerBirths: MapManager::pendingBirths()) {
+        workerBirths.clear();
+    }
+}
+
+bool MapManager::saveMapToFile(const string &filePath, bool compressed) {
+    TraceSpan saveSpan("saveMapToFile");
+    ofstream mapFileStream(filePath, ios::binary);
     if (!mapFileStream.is_open()) {
         return false;
     }
 
-    for (int currentRow = 0; currentRow < mapRows; currentRow++) {
-        string lineToAdd;
-        for (int currentCol = 0; currentCol < mapColumns; currentCol++) {
-            currentLocation = {currentCol, currentRow};
-            auto floraFaunaIter = MapManager::floraFauna.find(currentLocation);
-            auto terrainIter = MapManager::terrain.find(currentLocation);
-            if (floraFaunaIter != MapManager::floraFauna.end()) {
-                // Animal element
-                lineToAdd += floraFaunaIter->second->getCharID();
-            } else if (terrainIter != MapManager::terrain.end()) {
-                // Terrain element
-                lineToAdd += terrainIter->second;
-            } else {
-                // Empty space
-                lineToAdd += " ";
-            }
+    const World &world = World::current();
+    vector<char> speciesChars(world.species.size());
+    for (size_t index = 0; index < world.species.size(); index++) {
+        speciesChars[index] = world.species[(SpeciesIndex) index].charID;
+    }
+
+    // Rows are gathered into a large buffer that is written in one go whenever it fills up
+    string outputBuffer = compressed ? RunLengthCodec::MAGIC : string();
+    outputBuffer.reserve(MAP_WRITE_BUFFER_SIZE + world.mapColumns + 1);
+    string row;
+    for (int currentRow = 0; currentRow < world.mapRows; currentRow++) {
+        row.clear();
+        for (int currentCol = 0; currentCol < world.mapColumns; currentCol++) {
+            Point currentLocation(currentCol, currentRow);
+            EntityId visibleElement = world.floraFauna.topElement(currentLocation);
+            row += visibleElement != NO_ENTITY ? speciesChars[world.entities.getSpecies(visibleElement)]
+                                               : TerrainRaster::toChar(world.terrain.get(currentLocation));
         }
-        // Write the line to the file
-        if (isFirstLineWritten) {
-            mapFileStream << endl;
-            mapFileStream << lineToAdd;
+        if (currentRow + 1 < world.mapRows) {
+            row += '\n';
+        }
+
+        if (compressed) {
+            RunLengthCodec::encode(row.data(), row.size(), outputBuffer);
         } else {
-            mapFileStream << lineToAdd;
-            isFirstLineWritten = true;
+            outputBuffer += row;
+        }
+        if (outputBuffer.size() >= MAP_WRITE_BUFFER_SIZE) {
+            mapFileStream.write(outputBuffer.data(), (streamsize) outputBuffer.size());
+            outputBuffer.clear();
         }
     }
+    mapFileStream.write(outputBuffer.data(), (streamsize) outputBuffer.size());
 
     mapFileStream.close();
-    return true;
+    return !mapFileStream.fail();
 }
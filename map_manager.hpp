@@ -1,71 +1,187 @@
 #ifndef ECOSIM_MAP_MANAGER_HPP
 #define ECOSIM_MAP_MANAGER_HPP
 
+#include <string>
 #include <vector>
-#include <map>
 
-#include "ecosystem_element.hpp"
+#include "entity_store.hpp"
+#include "species_table.hpp"
+#include "flora_fauna_grid.hpp"
+#include "terrain_raster.hpp"
+#include "event_scheduler.hpp"
+#include "world.hpp"
 
 using namespace std;
 
-using FloraFaunaList = multimap<Point, unique_ptr<EcosystemElement>>;
-using WaterObstacleList = map<Point, char>;
+/**
+ * Cells around an element matched by a neighbor query, at most its four cardinal neighbors. The cells are held
+ * inline so the queries every animal makes on every tick never allocate
+ */
+struct NeighborCells {
+    Point cells[4];
+    size_t count = 0;
 
+    void add(const Point &cell) { cells[count++] = cell; }
 
+    bool empty() const { return count == 0; }
+
+    size_t size() const { return count; }
+
+    const Point &operator[](size_t index) const { return cells[index]; }
+
+    const Point *begin() const { return cells; }
+
+    const Point *end() const { return cells + count; }
+};
+
+/**
+ * Acts on the simulation state of the calling thread's current world. The world is double buffered: floraFauna and
+ * entities hold the committed state that every query reads, while moves, meals, births and deaths are written into
+ * nextFloraFauna and nextEntities. A write that conflicts with an earlier write in the same phase is rejected, so
+ * each element acts on the state it observed and is updated at most once per phase. swapBuffers commits the pending
+ * state
+ */
 class MapManager {
 public:
     /**
-    * Returns a vector of locations that contain edible food around the element
-    * @param element ecosystem element to check surroundings on
-    * @return vector of points that contain edible food
+    * Returns the locations that contain edible food around the element
+    * @param id ecosystem element to check surroundings on
+    * @return points that contain edible food
     */
-    static vector<Point> edibleFloraFaunaNearby(const EcosystemElement &element);
+    static NeighborCells edibleFloraFaunaNearby(EntityId id);
 
     /**
-    * Returns a vector of empty locations on the map around the element
-    * @param element ecosystem element to check surroundings on
-    * @return vector of points that are free locations to move to
+    * Returns the empty locations on the map around the element
+    * @param id ecosystem element to check surroundings on
+    * @return points that are free locations to move to
     */
-    static vector<Point> freeLocations(const EcosystemElement &element);
+    static NeighborCells freeLocations(EntityId id);
 
     /**
      * Find viable mates in the location around an animal
-     * @param element element to find mates for
-     * @return vector of points that contain viable mates
+     * @param id element to find mates for
+     * @return points that contain viable mates
      */
-    static vector<Point> nearbyMates(const EcosystemElement &element);
+    static NeighborCells nearbyMates(EntityId id);
 
     /**
     * Moves an element to the specified location
-    * @param ecosystemElement element to move
+    * @param id element to move
     * @param newLocation new location for the element to occupy
+    * @return false if another animal already claimed the location during this phase
     */
-    static void moveElement(EcosystemElement &elementToMove, const Point &newLocation);
+    static bool moveElement(EntityId id, const Point &newLocation);
 
     /**
     * Moves the element doing the eating to the position of the animal to be eaten and consumes them
-    * @param elementEating element doing the eating
+    * @param eaterId element doing the eating
     * @param locationToEat point location for the targeted element to be eaten
+    * @return false if the food was already eaten, moved away or the location was claimed during this phase
     */
-    static void eatElement(EcosystemElement &elementEating, const Point &locationToEat);
+    static bool eatElement(EntityId eaterId, const Point &locationToEat);
 
     /**
-    * Removes the element from the simulation
-    * @param element element to remove
+     * Sets the pending energy of an element. Energy is only ever changed through here, so the population recording
+     * can keep its energy totals up to date from the changes alone
+     * @param id element whose energy changes
+     * @param energy new energy level
+     */
+    static void setEnergy(EntityId id, int energy);
+
+    /**
+    * Removes the element from the simulation. Only animals are ever removed, plants regrow instead
+    * @param id element to remove
     */
-    static void killElement(EcosystemElement &element);
+    static void killElement(EntityId id);
+
+    /**
+     * Creates a new element of the given species at full energy and places it on the map
+     * @param speciesIndex index of the species in the species table
+     * @param location point location for the new element
+     * @return id of the new element or NO_ENTITY if the location was claimed during this phase
+     */
+    static EntityId spawnElement(SpeciesIndex speciesIndex, const Point &location);
+
+    /**
+     * Claims a free cell for a newborn of the given species. The element is created when the phase is committed, so
+     * births do not depend on the order in which animals were ticked
+     * @param speciesIndex index of the newborn's species in the species table
+     * @param location point location for the newborn
+     * @return false if the location was claimed during this phase
+     */
+    static bool queueBirth(SpeciesIndex speciesIndex, const Point &location);
+
+    /**
+     * Commits the pending state written during the current phase. Queued births are created in row-major order of
+     * their cells, events scheduled during the phase enter the scheduler, the buffers are swapped and only the cells
+     * and slots that changed are copied back into the new pending buffers
+     */
+    static void swapBuffers();
+
+    /**
+     * Sets the number of pool workers that may run phase tasks concurrently
+     * @param workerCount number of workers
+     */
+    static void setWorkerCount(int workerCount);
 
     /**
-     * Save the map out to the specified filepath
+     * Discards all elements and pending changed cells and sizes both buffers for a map with the given dimensions
+     * @param rows number of rows in the map
+     * @param columns number of columns in the map
+     */
+    static void resetWorld(int rows, int columns);
+
+    /**
+     * Save the map out to the specified filepath. Rows are streamed to the file through a large buffer, optionally
+     * run-length encoded on the way. loadMap reads both forms
      * @param filePath filepath
+     * @param compressed whether to run-length encode the map
      * @return boolean value representing if the operation was successful or not
      */
-    static bool saveMapToFile(const string &filePath);
+    static bool saveMapToFile(const string &filePath, bool compressed = false);
+
+    static const Species &speciesOf(EntityId id) { return species()[entities().getSpecies(id)]; }
+
+    // State of the calling thread's current world
+    static FloraFaunaGrid &floraFauna() { return World::current().floraFauna; }
+
+    static FloraFaunaGrid &nextFloraFauna() { return World::current().nextFloraFauna; }
+
+    static TerrainRaster &terrain() { return World::current().terrain; }
+
+    static EntityStore &entities() { return World::current().entities; }
+
+    static EntityStore &nextEntities() { return World::current().nextEntities; }
+
+    static SpeciesTable &species() { return World::current().species; }
+
+    static EventScheduler &events() { return World::current().events; }
 
-    static FloraFaunaList floraFauna;
-    static WaterObstacleList terrain;
-    static int mapRows;
-    static int mapColumns;
+    static vector<vector<pair<Point, SpeciesIndex>>> &pendingBirths() { return World::current().pendingBirths; }
+
+    static int &mapRows() { return World::current().mapRows; }
+
+    static int &mapColumns() { return World::current().mapColumns; }
+
+    static bool &trackChangedCells() { return World::current().trackChangedCells; }
+
+    static vector<size_t> &changedCells() { return World::current().changedCells; }
+
+private:
+    /**
+     * Moves an element like moveElement without recording the move in the action log, so eating is logged as one
+     * action
+     * @param id element to move
+     * @param newLocation new location for the element to occupy
+     * @return false if another animal already claimed the location during this phase
+     */
+    static bool relocateElement(EntityId id, const Point &newLocation);
+
+    /**
+     * Removes an animal like killElement without recording the death in the action log
+     * @param id element to remove
+     */
+    static void removeElement(EntityId id);
 };
 
 
@@ -0,0 +1,264 @@
+#include "map_renderer.hpp"
+
+#include <algorithm>
+
+#include "map_manager.hpp"
+#include "tick_engine.hpp"
+#include "tick_stats.hpp"
+#include "trace_recorder.hpp"
+
+// Colour pairs of terrain and of plants that were eaten and have not regrown yet
+static const short WATER_COLOR_PAIR = 2;
+static const short OBSTACLE_COLOR_PAIR = 3;
+static const short EATEN_PLANT_COLOR_PAIR = 6;
+
+Viewport::Viewport(int windowRows, int windowColumns) : windowRows(max(1, windowRows)),
+                                                         windowColumns(max(1, windowColumns)) {}
+
+void Viewport::scrollBy(int rowDelta, int columnDelta) {
+    top = max(0, min(MapManager::mapRows() - getRows(), top + rowDelta));
+    left = max(0, min(MapManager::mapColumns() - getColumns(), left + columnDelta));
+}
+
+int Viewport::getRows() const {
+    return min(windowRows, MapManager::mapRows());
+}
+
+int Viewport::getColumns() const {
+    return min(windowColumns, MapManager::mapColumns());
+}
+
+int Viewport::getBlockSize() const {
+    int rowBlockSize = (MapManager::mapRows() + windowRows - 1) / windowRows;
+    int columnBlockSize = (MapManager::mapColumns() + windowColumns - 1) / windowColumns;
+    return max(1, max(rowBlockSize, columnBlockSize));
+}
+
+FrameCapture::FrameCapture(const Viewport &viewport) : viewport(viewport) {
+    MapManager::trackChangedCells() = true;
+    MapManager::changedCells().clear();
+}
+
+FrameCapture::~FrameCapture() {
+    MapManager::trackChangedCells() = false;
+    MapManager::changedCells().clear();
+}
+
+void FrameCapture::capture(MapFrame &frame) {
+    PhaseTimer phaseTimer(DRAW_PHASE);
+    // The render thread may move the viewport at any time, so it is read once per capture
+    bool overview = viewport.isOverview();
+    int top = viewport.getTop();
+    int left = viewport.getLeft();
+    int rows = viewport.getRows();
+    int columns = viewport.getColumns();
+    // Glyphs kept from the last capture can only be patched while the same part of the map stays in view
+    bool viewMoved = overview || top != viewTop || left != viewLeft || rows != viewRows || columns != viewColumns;
+
+    if (blockSize != viewport.getBlockSize() || speciesCount != MapManager::species().size() ||
+        cellKeys.size() != (size_t) MapManager::mapRows() * MapManager::mapColumns()) {
+        rebuildBlockCounts();
+        viewMoved = true;
+    } else {
+        for (size_t index: MapManager::changedCells()) {
+            updateCellKey(index);
+            int row = (int) (index / MapManager::mapColumns());
+            int column = (int) (index % MapManager::mapColumns());
+            if (!viewMoved && row >= top && row < top + rows && column >= left && column < left + columns) {
+                viewGlyphs[(size_t) (row - top) * columns + (column - left)] = glyphAt(index);
+            }
+        }
+    }
+    MapManager::changedCells().clear();
+
+    frame.tick = TickEngine::getTickCount();
+    if (overview) {
+        frame.rows = blockRows;
+        frame.columns = blockColumns;
+        frame.glyphs.resize((size_t) frame.rows * frame.columns);
+        for (int blockRow = 0; blockRow < blockRows; blockRow++) {
+            for (int blockColumn = 0; blockColumn < blockColumns; blockColumn++) {
+                frame.glyphs[(size_t) blockRow * blockColumns + blockColumn] = blockGlyph(blockRow, blockColumn);
+            }
+        }
+        // Cells changed while the overview is shown are not patched, so the next view is captured in full
+        viewRows = 0;
+        return;
+    }
+
+    if (viewMoved) {
+        viewTop = top;
+        viewLeft = left;
+        viewRows = rows;
+        viewColumns = columns;
+        viewGlyphs.resize((size_t) rows * columns);
+        for (int row = 0; row < rows; row++) {
+            size_t rowStart = (size_t) (top + row) * MapManager::mapColumns() + left;
+            for (int column = 0; column < columns; column++) {
+                viewGlyphs[(size_t) row * columns + column] = glyphAt(rowStart + column);
+            }
+        }
+    }
+    frame.rows = rows;
+    frame.columns = columns;
+    frame.glyphs = viewGlyphs;
+}
+
+CellGlyph FrameCapture::glyphAt(size_t cellIndex) {
+    Point location((int) (cellIndex % MapManager::mapColumns()), (int) (cellIndex / MapManager::mapColumns()));
+    EntityId visibleElement = MapManager::floraFauna().topElement(location);
+    if (visibleElement != NO_ENTITY) {
+        const Species &elementSpecies = MapManager::speciesOf(visibleElement);
+        bool isEatenPlant = elementSpecies.speciesType == SpeciesType::PLANT &&
+                            !MapManager::entities().isGrown(visibleElement);
+        return {elementSpecies.charID, isEatenPlant ? EATEN_PLANT_COLOR_PAIR : elementSpecies.colorPair};
+    }
+
+    switch (MapManager::terrain().get(location)) {
+        case WATER:
+            return {'~', WATER_COLOR_PAIR};
+        case OBSTACLE:
+            return {'#', OBSTACLE_COLOR_PAIR};
+        default:
+            return {};
+    }
+}
+
+void FrameCapture::rebuildBlockCounts() {
+    blockSize = viewport.getBlockSize();
+    blockRows = (MapManager::mapRows() + blockSize - 1) / blockSize;
+    blockColumns = (MapManager::mapColumns() + blockSize - 1) / blockSize;
+    speciesCount = MapManager::species().size();
+    size_t blockCount = (size_t) blockRows * blockColumns;
+    blockSpeciesCounts.assign(blockCount * speciesCount, 0);
+    blockWaterCounts.assign(blockCount, 0);
+    blockObstacleCounts.assign(blockCount, 0);
+    cellKeys.assign((size_t) MapManager::mapRows() * MapManager::mapColumns(), NO_KEY);
+
+    MapManager::terrain().forEachTerrain([&](const Point &location, TerrainType terrainType) {
+        size_t block = (size_t) (location.second / blockSize) * blockColumns + location.first / blockSize;
+        (terrainType == WATER ? blockWaterCounts : blockObstacleCounts)[block]++;
+    });
+    MapManager::floraFauna().forEachElement([&](EntityId id) {
+        const Point &location = MapManager::entities().getLocation(id);
+        size_t cellIndex = (size_t) location.second * MapManager::mapColumns() + location.first;
+        if (cellKeys[cellIndex] == NO_KEY) {
+            updateCellKey(cellIndex);
+        }
+    });
+}
+
+void FrameCapture::updateCellKey(size_t cellIndex) {
+    uint16_t newKey = keyOf(cellIndex);
+    uint16_t &cellKey = cellKeys[cellIndex];
+    if (newKey == cellKey) {
+        return;
+    }
+
+    size_t row = cellIndex / MapManager::mapColumns();
+    size_t column = cellIndex % MapManager::mapColumns();
+    size_t block = (row / blockSize) * blockColumns + column / blockSize;
+    if (cellKey != NO_KEY) {
+        blockSpeciesCounts[block * speciesCount + cellKey]--;
+    }
+    if (newKey != NO_KEY) {
+        blockSpeciesCounts[block * speciesCount + newKey]++;
+    }
+    cellKey = newKey;
+}
+
+uint16_t FrameCapture::keyOf(size_t cellIndex) {
+    Point location((int) (cellIndex % MapManager::mapColumns()), (int) (cellIndex / MapManager::mapColumns()));
+    EntityId visibleElement = MapManager::floraFauna().topElement(location);
+    return visibleElement == NO_ENTITY ? NO_KEY : (uint16_t) MapManager::entities().getSpecies(visibleElement);
+}
+
+CellGlyph FrameCapture::blockGlyph(int blockRow, int blockColumn) const {
+    size_t block = (size_t) blockRow * blockColumns + blockColumn;
+    const uint32_t *speciesCounts = blockSpeciesCounts.data() + block * speciesCount;
+    size_t dominantSpecies = 0;
+    for (size_t index = 1; index < speciesCount; index++) {
+        if (speciesCounts[index] > speciesCounts[dominantSpecies]) {
+            dominantSpecies = index;
+        }
+    }
+    if (speciesCount > 0 && speciesCounts[dominantSpecies] > 0) {
+        const Species &blockSpecies = MapManager::species()[(SpeciesIndex) dominantSpecies];
+        return {blockSpecies.charID, blockSpecies.colorPair};
+    }
+
+    // Blocks along the bottom and right edges may be cut short by the map
+    int blockHeight = min(blockSize, MapManager::mapRows() - blockRow * blockSize);
+    int blockWidth = min(blockSize, MapManager::mapColumns() - blockColumn * blockSize);
+    uint32_t terrainCount = blockWaterCounts[block] + blockObstacleCounts[block];
+    if (terrainCount * 2 < (uint32_t) (blockHeight * blockWidth)) {
+        return {};
+    }
+    return blockWaterCounts[block] >= blockObstacleCounts[block] ? CellGlyph{'~', WATER_COLOR_PAIR}
+                                                                 : CellGlyph{'#', OBSTACLE_COLOR_PAIR};
+}
+
+bool MapRenderer::collectChanges(const MapFrame &frame) {
+    for (auto &bucket: colorBuckets) {
+        bucket.clear();
+    }
+
+    bool fullRepaint = shownRows != frame.rows || shownColumns != frame.columns;
+    if (fullRepaint) {
+        shownRows = frame.rows;
+        shownColumns = frame.columns;
+        shownGlyphs.assign(frame.glyphs.size(), CellGlyph());
+    }
+    for (size_t index = 0; index < frame.glyphs.size(); index++) {
+        if (frame.glyphs[index] != shownGlyphs[index]) {
+            addChange(index, frame.glyphs[index]);
+        }
+    }
+    return fullRepaint;
+}
+
+void MapRenderer::addChange(size_t cellIndex, const CellGlyph &glyph) {
+    if ((size_t) glyph.colorPair >= colorBuckets.size()) {
+        colorBuckets.resize(glyph.colorPair + 1);
+    }
+    colorBuckets[glyph.colorPair].emplace_back(cellIndex, glyph.character);
+    shownGlyphs[cellIndex] = glyph;
+}
+
+#ifndef CURSES_DISABLED
+
+void MapRenderer::draw(WINDOW *window, const MapFrame &frame, bool hasBorder) {
+    TraceSpan drawSpan("drawMap", frame.tick);
+    int windowRows, windowColumns;
+    getmaxyx(window, windowRows, windowColumns);
+    int borderWidth = hasBorder ? 1 : 0;
+    int mapOffsetY = max(borderWidth, (windowRows - frame.rows) / 2);
+    int mapOffsetX = max(borderWidth, (windowColumns - frame.columns) / 2);
+
+    if (collectChanges(frame)) {
+        wclear(window);
+        if (hasBorder) {
+            wattron(window, COLOR_PAIR(1));
+            box(window, 0, 0);
+            wattroff(window, COLOR_PAIR(1));
+        }
+    }
+
+    // Cursor location entered in the form row, column (y, x)
+    for (size_t colorPair = 0; colorPair < colorBuckets.size(); colorPair++) {
+        if (colorBuckets[colorPair].empty()) {
+            continue;
+        }
+        wattron(window, COLOR_PAIR(colorPair));
+        for (const auto &change: colorBuckets[colorPair]) {
+            mvwaddch(window, (int) (change.first / shownColumns) + mapOffsetY,
+                     (int) (change.first % shownColumns) + mapOffsetX, change.second);
+        }
+        wattroff(window, COLOR_PAIR(colorPair));
+    }
+
+    wmove(window, 1, 1);
+    wrefresh(window);
+}
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef ECOSIM_MAP_RENDERER_HPP
+#define ECOSIM_MAP_RENDERER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "ncurses.h"
+
+/**
+ * Character and colour pair a map cell is drawn with
+ */
+struct CellGlyph {
+    char character = ' ';
+    short colorPair = 0;
+
+    bool operator==(const CellGlyph &other) const {
+        return character == other.character && colorPair == other.colorPair;
+    }
+
+    bool operator!=(const CellGlyph &other) const { return !(*this == other); }
+};
+
+/**
+ * Snapshot of the visible part of the map after a tick, detached from the simulation state so another thread can
+ * draw it. In the overview every glyph stands for a block of cells
+ */
+struct MapFrame {
+    long tick = 0;
+    int rows = 0;
+    int columns = 0;
+    std::vector<CellGlyph> glyphs;
+};
+
+/**
+ * Part of the map shown in the simulation window. The render thread scrolls it and switches to the overview, which
+ * shrinks the whole map to fit the window, while the simulation thread reads it to capture frames, so the position
+ * and mode are atomic
+ */
+class Viewport {
+public:
+    /**
+     * @param windowRows rows of the window available to the map
+     * @param windowColumns columns of the window available to the map
+     */
+    Viewport(int windowRows, int windowColumns);
+
+    /**
+     * Moves the visible part of the map, stopping at its edges
+     * @param rowDelta rows to move down, negative to move up
+     * @param columnDelta columns to move right, negative to move left
+     */
+    void scrollBy(int rowDelta, int columnDelta);
+
+    void toggleOverview() { overview = !overview; }
+
+    bool isOverview() const { return overview; }
+
+    int getTop() const { return top; }
+
+    int getLeft() const { return left; }
+
+    /**
+     * Returns the number of map rows shown when not in the overview
+     */
+    int getRows() const;
+
+    /**
+     * Returns the number of map columns shown when not in the overview
+     */
+    int getColumns() const;
+
+    /**
+     * Returns the edge length of the square blocks of cells the overview summarises in one character. Blocks are as
+     * small as possible while still fitting the whole map in the window
+     * @return block edge length in cells
+     */
+    int getBlockSize() const;
+
+private:
+    const int windowRows;
+    const int windowColumns;
+    std::atomic<int> top{0};
+    std::atomic<int> left{0};
+    std::atomic<bool> overview{false};
+};
+
+/**
+ * Simulation side of the view. While it exists MapManager collects the cells each commit touches, which keeps a
+ * count of every species, water and obstacle cell per overview block up to date without rescanning the map. The
+ * glyphs of the viewport are kept between captures as well and only the changed cells inside it are looked up
+ * again, so a capture costs as much as a tick changed, plus copying the window. Moving the viewport or leaving the
+ * overview captures the window in full once.
+ *
+ * Overview blocks show their most common species. Blocks without plants or animals show water or obstacles when
+ * those cover at least half of the block
+ */
+class FrameCapture {
+public:
+    /**
+     * @param viewport part of the map to capture
+     */
+    explicit FrameCapture(const Viewport &viewport);
+
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture &) = delete;
+
+    FrameCapture &operator=(const FrameCapture &) = delete;
+
+    /**
+     * Brings the block counts and kept viewport glyphs up to date with the committed world and copies the viewport
+     * into a frame. Must be called between ticks
+     * @param frame frame to overwrite
+     */
+    void capture(MapFrame &frame);
+
+    /**
+     * Computes the glyph a cell of the committed world is drawn with
+     * @param cellIndex row-major index of the cell
+     * @return glyph of the cell
+     */
+    static CellGlyph glyphAt(size_t cellIndex);
+
+private:
+    /**
+     * Recounts every block for the current block size and map
+     */
+    void rebuildBlockCounts();
+
+    /**
+     * Moves a cell's contribution to the counts of its block from what it held to what it holds now
+     * @param cellIndex row-major index of the cell
+     */
+    void updateCellKey(size_t cellIndex);
+
+    /**
+     * Returns the species index a cell counts towards, or NO_KEY if it holds no element
+     */
+    static uint16_t keyOf(size_t cellIndex);
+
+    /**
+     * Computes the glyph an overview block is drawn with
+     * @param blockRow row of the block
+     * @param blockColumn column of the block
+     * @return glyph of the block
+     */
+    CellGlyph blockGlyph(int blockRow, int blockColumn) const;
+
+    static constexpr uint16_t NO_KEY = UINT16_MAX;
+
+    const Viewport &viewport;
+    int blockSize = 0;
+    int blockRows = 0;
+    int blockColumns = 0;
+    size_t speciesCount = 0;
+    // Species index each cell is currently counted as
+    std::vector<uint16_t> cellKeys;
+    // Cells of every species per block, indexed by block * speciesCount + species index
+    std::vector<uint32_t> blockSpeciesCounts;
+    std::vector<uint32_t> blockWaterCounts;
+    std::vector<uint32_t> blockObstacleCounts;
+    // Glyphs of the part of the map captured last, outside of the overview
+    std::vector<CellGlyph> viewGlyphs;
+    int viewTop = 0;
+    int viewLeft = 0;
+    int viewRows = 0;
+    int viewColumns = 0;
+};
+
+/**
+ * Drawing side of the view. The renderer remembers the glyph it last drew at every position of the window and only
+ * emits the positions a new frame changes, grouped by colour pair so that every pair is switched on once per frame.
+ * Frames may be skipped, since each one is compared against what is actually on screen. The frame is centered in
+ * the window.
+ *
+ * The first frame, and any frame with different dimensions, repaints the whole window
+ */
+class MapRenderer {
+public:
+    /**
+     * Works out which positions of the frame look different from what was last drawn and records them as shown
+     * @param frame frame about to be drawn
+     * @return true if the whole window has to be repainted, in which case every non-blank position is returned
+     */
+    bool collectChanges(const MapFrame &frame);
+
+    /**
+     * Returns the positions collected by the last collectChanges, grouped by colour pair
+     * @return for every colour pair, the row-major frame index and character of each position to draw with it
+     */
+    const std::vector<std::vector<std::pair<size_t, char>>> &changesByColor() const { return colorBuckets; }
+
+#ifndef CURSES_DISABLED
+
+    /**
+     * Draws the positions of the frame that changed since the last frame drawn
+     * @param window window to draw in
+     * @param frame frame to draw
+     * @param hasBorder whether the window has a border to keep clear of and restore on a full repaint
+     */
+    void draw(WINDOW *window, const MapFrame &frame, bool hasBorder);
+
+#endif
+
+private:
+    /**
+     * Adds a position to the bucket of its colour pair
+     */
+    void addChange(size_t frameIndex, const CellGlyph &glyph);
+
+    std::vector<CellGlyph> shownGlyphs;
+    std::vector<std::vector<std::pair<size_t, char>>> colorBuckets;
+    int shownRows = -1;
+    int shownColumns = -1;
+};
+
+#endif //ECOSIM_MAP_RENDERER_HPP
@@ -3,30 +3,31 @@
 #include "map_manager.hpp"
 #include "sim_utilities.hpp"
 
-void Omnivore::tick() {
+void Omnivore::tick(EntityId id, CounterRng &rng) {
     Point actionableLocation;
-    auto availableLocations = MapManager::freeLocations(*this);
-    auto foodNearby = MapManager::edibleFloraFaunaNearby(*this);
-    auto matesNearby = MapManager::nearbyMates(*this);
+    int currentEnergy = MapManager::entities().getEnergy(id);
+    int maxEnergy = MapManager::speciesOf(id).energy;
+    auto availableLocations = MapManager::freeLocations(id);
+    auto foodNearby = MapManager::edibleFloraFaunaNearby(id);
+    auto matesNearby = MapManager::nearbyMates(id);
 
     if (!foodNearby.empty() && currentEnergy < (0.3 * maxEnergy)) {
         // Prioritize eating if energy levels are getting low
-        actionableLocation = SimUtilities::randomSelect(foodNearby, 1)[0];
-        MapManager::eatElement(*this, actionableLocation);
+        actionableLocation = SimUtilities::randomPick(foodNearby, rng);
+        MapManager::eatElement(id, actionableLocation);
     } else if (!matesNearby.empty() && matesNearby.size() < 3 && currentEnergy > (0.5 * maxEnergy) &&
-               !availableLocations.empty() && SimUtilities::getValUniformRandDist() > 0.85) {
+               !availableLocations.empty() && SimUtilities::getValUniformRandDist(rng) > 0.85) {
         // Produce offspring if energy levels are at a high enough level, the probability threshold
         // is reached, and the number of mates available is less than 3 (to avoid overpopulation)
-        actionableLocation = SimUtilities::randomSelect(availableLocations, 1)[0];
-        MapManager::floraFauna.insert(
-                pair(actionableLocation, make_unique<Omnivore>(charID, actionableLocation, foodChain, maxEnergy)));
+        actionableLocation = SimUtilities::randomPick(availableLocations, rng);
+        MapManager::queueBirth(MapManager::entities().getSpecies(id), actionableLocation);
     } else if (!availableLocations.empty()) {
         // Randomly pick a location to move to (emulates running from predator as well)
-        actionableLocation = SimUtilities::randomSelect(availableLocations, 1)[0];
-        MapManager::moveElement(*this, actionableLocation);
+        actionableLocation = SimUtilities::randomPick(availableLocations, rng);
+        MapManager::moveElement(id, actionableLocation);
     }
 }
 
-void Omnivore::makeEaten() {
-    currentEnergy = 0;
+void Omnivore::makeEaten(EntityId id) {
+    MapManager::setEnergy(id, 0);
 }
@@ -1,18 +1,22 @@
 #include "plant.hpp"
 
-void Plant::tick() {
-    if (!isGrown) {
-        regrowthStep++;
-        if (regrowthStep == regrowthCoeff) {
-            isGrown = true;
-            colorPair = 1;
-        }
-    }
+#include <algorithm>
 
+#include "action_log.hpp"
+#include "map_manager.hpp"
+#include "population_recorder.hpp"
+#include "tick_engine.hpp"
+
+void Plant::regrow(EntityId id) {
+    MapManager::nextEntities().setGrown(id, true);
+    PopulationRecorder::countEvent(PLANT_REGROWN_COUNT, MapManager::nextEntities().getSpecies(id));
+    ActionLog::recordRegrow(id);
 }
 
-void Plant::makeEaten() {
-    isGrown = false;
-    regrowthStep = 0;
-    colorPair = 6;
-}
\ No newline at end of file
+void Plant::makeEaten(EntityId id) {
+    MapManager::nextEntities().setGrown(id, false);
+    PopulationRecorder::countEvent(PLANT_EATEN_COUNT, MapManager::nextEntities().getSpecies(id));
+    // Regrowth takes at least one tick so it always happens in a later plant phase
+    long regrowthTicks = std::max(1, MapManager::speciesOf(id).regrowthCoeff);
+    MapManager::events().schedule(TickEngine::getTickCount() + regrowthTicks, id, REGROWN_EVENT);
+}
@@ -0,0 +1,229 @@
+#include "population_recorder.hpp"
+
+#include <cstring>
+#include <iomanip>
+
+#include "map_manager.hpp"
+#include "world.hpp"
+
+/**
+ * Fixed-size start of every recording, followed by the character IDs of the recorded species
+ */
+struct PopulationHeader {
+    char magic[8];
+    uint32_t version;
+};
+
+static const char POPULATION_MAGIC[8] = {'E', 'C', 'O', 'S', 'I', 'M', 'P', 'R'};
+
+bool PopulationRecorder::recording = false;
+PopulationRecorder::SpeciesCounts PopulationRecorder::tickCounts;
+std::vector<int64_t> PopulationRecorder::regrowingPlants;
+std::vector<int64_t> PopulationRecorder::energyTotals;
+PopulationChunk PopulationRecorder::currentChunk;
+std::unique_ptr<BinaryWriter> PopulationRecorder::writer;
+std::thread PopulationRecorder::writerThread;
+std::mutex PopulationRecorder::queueMutex;
+std::condition_variable PopulationRecorder::queueChanged;
+std::deque<PopulationChunk> PopulationRecorder::queuedChunks;
+bool PopulationRecorder::stopping = false;
+
+bool PopulationRecorder::start(const std::string &filePath) {
+    stop();
+    writer = std::make_unique<BinaryWriter>(filePath);
+    if (!writer->good()) {
+        writer.reset();
+        return false;
+    }
+
+    PopulationHeader header{};
+    memcpy(header.magic, POPULATION_MAGIC, sizeof(header.magic));
+    header.version = FORMAT_VERSION;
+    writer->write(header);
+    size_t speciesCount = MapManager::species().size();
+    std::vector<char> speciesIds;
+    for (size_t index = 0; index < speciesCount; index++) {
+        speciesIds.push_back(MapManager::species()[(SpeciesIndex) index].charID);
+    }
+    writer->writeArray(speciesIds);
+
+    tickCounts.assign(speciesCount, {});
+    for (PopulationCountsData::WorkerCounts &worker: World::current().populationCounts.workerCounts) {
+        worker.counts.assign(speciesCount, {});
+        worker.energyChanges.assign(speciesCount, 0);
+    }
+    // Elements are only scanned once here, every later change is tracked through the counted events and energy
+    // changes
+    regrowingPlants.assign(speciesCount, 0);
+    energyTotals.assign(speciesCount, 0);
+    for (size_t index = 0; index < speciesCount; index++) {
+        for (EntityId id: MapManager::entities().membersOf((SpeciesIndex) index)) {
+            regrowingPlants[index] += !MapManager::entities().isGrown(id);
+            energyTotals[index] += MapManager::entities().getEnergy(id);
+        }
+    }
+
+    currentChunk = PopulationChunk();
+    stopping = false;
+    writerThread = std::thread(writeChunks);
+    recording = true;
+    return true;
+}
+
+void PopulationRecorder::recordTick(long tick) {
+    if (!recording) {
+        return;
+    }
+    collectEvents();
+
+    currentChunk.ticks.push_back(tick);
+    for (size_t index = 0; index < tickCounts.size(); index++) {
+        std::array<uint32_t, POPULATION_EVENT_COUNT> &counts = tickCounts[index];
+        regrowingPlants[index] += (int64_t) counts[PLANT_EATEN_COUNT] - counts[PLANT_REGROWN_COUNT];
+
+        currentChunk.populations.push_back((uint32_t) MapManager::entities().countOf((SpeciesIndex) index));
+        currentChunk.totalEnergies.push_back(energyTotals[index]);
+        currentChunk.births.push_back(counts[BIRTH_COUNT]);
+        currentChunk.deaths.push_back(counts[DEATH_COUNT]);
+        currentChunk.plantsEaten.push_back(counts[PLANT_EATEN_COUNT]);
+        currentChunk.plantsRegrowing.push_back((uint32_t) regrowingPlants[index]);
+        counts.fill(0);
+    }
+
+    if (currentChunk.ticks.size() == CHUNK_TICKS) {
+        queueChunk();
+    }
+}
+
+void PopulationRecorder::setWorkerCount(int workerCount) {
+    // Fold counts of workers that are about to go away into the current tick first
+    if (recording) {
+        collectEvents();
+    }
+    std::vector<PopulationCountsData::WorkerCounts> &workerCounts = World::current().populationCounts.workerCounts;
+    size_t speciesCount = workerCounts[0].counts.size();
+    workerCounts.resize(workerCount);
+    for (PopulationCountsData::WorkerCounts &worker: workerCounts) {
+        worker.counts.resize(speciesCount);
+        worker.energyChanges.resize(speciesCount);
+    }
+}
+
+bool PopulationRecorder::stop() {
+    if (!recording) {
+        return true;
+    }
+    recording = false;
+    if (!currentChunk.ticks.empty()) {
+        queueChunk();
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueChanged.notify_one();
+    writerThread.join();
+
+    bool written = writer->good();
+    writer.reset();
+    return written;
+}
+
+bool PopulationRecorder::exportCsv(const std::string &filePath, std::ostream &outputStream) {
+    BinaryReader reader(filePath);
+    PopulationHeader header{};
+    std::vector<char> speciesIds;
+    if (!reader.isOpen() || !reader.read(header) || memcmp(header.magic, POPULATION_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != FORMAT_VERSION || !reader.readArray(speciesIds)) {
+        return false;
+    }
+
+    outputStream << "tick,species,population,total_energy,mean_energy,births,deaths,plants_eaten,plants_regrowing"
+                 << std::endl;
+    outputStream << std::fixed << std::setprecision(3);
+    PopulationChunk chunk;
+    while (!reader.atEnd()) {
+        if (!reader.readArray(chunk.ticks) || !reader.readArray(chunk.populations) ||
+            !reader.readArray(chunk.totalEnergies) || !reader.readArray(chunk.births) ||
+            !reader.readArray(chunk.deaths) || !reader.readArray(chunk.plantsEaten) ||
+            !reader.readArray(chunk.plantsRegrowing)) {
+            return false;
+        }
+        size_t valueCount = chunk.ticks.size() * speciesIds.size();
+        for (const auto *column: {&chunk.populations, &chunk.births, &chunk.deaths, &chunk.plantsEaten,
+                                  &chunk.plantsRegrowing}) {
+            if (column->size() != valueCount) {
+                return false;
+            }
+        }
+        if (chunk.totalEnergies.size() != valueCount) {
+            return false;
+        }
+
+        for (size_t tickIndex = 0; tickIndex < chunk.ticks.size(); tickIndex++) {
+            for (size_t index = 0; index < speciesIds.size(); index++) {
+                size_t value = tickIndex * speciesIds.size() + index;
+                uint32_t population = chunk.populations[value];
+                double meanEnergy = population ? (double) chunk.totalEnergies[value] / population : 0.0;
+                outputStream << chunk.ticks[tickIndex] << ',' << speciesIds[index] << ',' << population << ','
+                             << chunk.totalEnergies[value] << ',' << meanEnergy << ',' << chunk.births[value] << ','
+                             << chunk.deaths[value] << ',' << chunk.plantsEaten[value] << ','
+                             << chunk.plantsRegrowing[value] << '\n';
+            }
+        }
+    }
+    return outputStream.good();
+}
+
+void PopulationRecorder::countWorkerEvent(PopulationEvent event, SpeciesIndex speciesIndex) {
+    World::current().populationCounts.workerCounts[ThreadPool::workerIndex()].counts[speciesIndex][event]++;
+}
+
+void PopulationRecorder::countWorkerEnergyChange(SpeciesIndex speciesIndex, int64_t change) {
+    World::current().populationCounts.workerCounts[ThreadPool::workerIndex()].energyChanges[speciesIndex] += change;
+}
+
+void PopulationRecorder::collectEvents() {
+    for (PopulationCountsData::WorkerCounts &worker: World::current().populationCounts.workerCounts) {
+        for (size_t index = 0; index < worker.counts.size() && index < tickCounts.size(); index++) {
+            for (int event = 0; event < POPULATION_EVENT_COUNT; event++) {
+                tickCounts[index][event] += worker.counts[index][event];
+            }
+            worker.counts[index].fill(0);
+            energyTotals[index] += worker.energyChanges[index];
+            worker.energyChanges[index] = 0;
+        }
+    }
+}
+
+void PopulationRecorder::queueChunk() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queuedChunks.push_back(std::move(currentChunk));
+    }
+    queueChanged.notify_one();
+    currentChunk = PopulationChunk();
+}
+
+void PopulationRecorder::writeChunks() {
+    while (true) {
+        PopulationChunk chunk;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueChanged.wait(lock, [] { return stopping || !queuedChunks.empty(); });
+            if (queuedChunks.empty()) {
+                return;
+            }
+            chunk = std::move(queuedChunks.front());
+            queuedChunks.pop_front();
+        }
+
+        writer->writeArray(chunk.ticks);
+        writer->writeArray(chunk.populations);
+        writer->writeArray(chunk.totalEnergies);
+        writer->writeArray(chunk.births);
+        writer->writeArray(chunk.deaths);
+        writer->writeArray(chunk.plantsEaten);
+        writer->writeArray(chunk.plantsRegrowing);
+    }
+}
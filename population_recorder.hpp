@@ -0,0 +1,159 @@
+#ifndef ECOSIM_POPULATION_RECORDER_HPP
+#define ECOSIM_POPULATION_RECORDER_HPP
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "binary_io.hpp"
+
+#include "species_table.hpp"
+#include "thread_pool.hpp"
+
+/**
+ * Per-species events counted while a recording runs
+ */
+enum PopulationEvent {
+    BIRTH_COUNT, DEATH_COUNT, PLANT_EATEN_COUNT, PLANT_REGROWN_COUNT, POPULATION_EVENT_COUNT
+};
+
+/**
+ * Events of one world counted by its pool workers that were not yet added to the recording. Every world keeps its
+ * own, so resizing them for a world's thread count never touches a world running on another thread
+ */
+struct PopulationCountsData {
+    struct alignas(64) WorkerCounts {
+        std::vector<std::array<uint32_t, POPULATION_EVENT_COUNT>> counts;
+        std::vector<int64_t> energyChanges;
+    };
+
+    std::vector<WorkerCounts> workerCounts = std::vector<WorkerCounts>(1);
+};
+
+/**
+ * Aggregates of every species for a range of ticks. Every field is its own column with one value per tick and
+ * species, ordered by tick and then species index
+ */
+struct PopulationChunk {
+    std::vector<int64_t> ticks;
+    std::vector<uint32_t> populations;
+    std::vector<int64_t> totalEnergies;
+    std::vector<uint32_t> births;
+    std::vector<uint32_t> deaths;
+    std::vector<uint32_t> plantsEaten;
+    std::vector<uint32_t> plantsRegrowing;
+};
+
+/**
+ * Records per-tick population time series of every species: population, total energy, births, deaths, plants eaten
+ * during the tick and plants waiting to regrow. Nothing scans the grid or the elements once the recording runs.
+ * Populations come from the entity store's member counts, and everything else from events and energy changes counted
+ * per pool worker of the recorded world as they happen, which keep running totals up to date.
+ *
+ * Ticks are gathered into chunks of CHUNK_TICKS that a background thread appends to the recording file, so the
+ * simulation never waits for the disk. The file starts with a header naming the species, followed by the chunks,
+ * each holding the tick count and one array per column
+ */
+class PopulationRecorder {
+public:
+    /**
+     * Starts recording the current world, which must not change species while the recording runs
+     * @param filePath filepath of the recording
+     * @return false if the file could not be opened
+     */
+    static bool start(const std::string &filePath);
+
+    static bool isRecording() { return recording; }
+
+    static void countEvent(PopulationEvent event, SpeciesIndex speciesIndex) {
+        if (recording) {
+            countWorkerEvent(event, speciesIndex);
+        }
+    }
+
+    static void countEnergyChange(SpeciesIndex speciesIndex, int64_t change) {
+        if (recording) {
+            countWorkerEnergyChange(speciesIndex, change);
+        }
+    }
+
+    /**
+     * Records the aggregates of a finished tick. Must be called between ticks
+     * @param tick number of the tick that finished
+     */
+    static void recordTick(long tick);
+
+    /**
+     * Sets the number of pool workers of the current world that may count events concurrently
+     * @param workerCount number of workers
+     */
+    static void setWorkerCount(int workerCount);
+
+    /**
+     * Writes the ticks still gathered, waits for the background writer and closes the recording
+     * @return false if any part of the recording could not be written
+     */
+    static bool stop();
+
+    /**
+     * Converts a recording to CSV with one row per tick and species, including the mean energy
+     * @param filePath filepath of the recording
+     * @param outputStream stream to write the CSV to
+     * @return false if the recording could not be read or is corrupt
+     */
+    static bool exportCsv(const std::string &filePath, std::ostream &outputStream);
+
+    static const uint32_t FORMAT_VERSION = 1;
+    static const size_t CHUNK_TICKS = 4096;
+
+private:
+    using SpeciesCounts = std::vector<std::array<uint32_t, POPULATION_EVENT_COUNT>>;
+
+    /**
+     * Counts an event for the calling worker of the current world
+     */
+    static void countWorkerEvent(PopulationEvent event, SpeciesIndex speciesIndex);
+
+    /**
+     * Counts an energy change for the calling worker of the current world
+     */
+    static void countWorkerEnergyChange(SpeciesIndex speciesIndex, int64_t change);
+
+    /**
+     * Adds the pending counts of every worker of the current world to the current tick
+     */
+    static void collectEvents();
+
+    /**
+     * Hands the gathered ticks to the background writer
+     */
+    static void queueChunk();
+
+    /**
+     * Appends queued chunks to the recording until stop is called and the queue is empty
+     */
+    static void writeChunks();
+
+    static bool recording;
+    // Events of the tick being run, and plants waiting to regrow and total energy of every species
+    static SpeciesCounts tickCounts;
+    static std::vector<int64_t> regrowingPlants;
+    static std::vector<int64_t> energyTotals;
+    static PopulationChunk currentChunk;
+
+    static std::unique_ptr<BinaryWriter> writer;
+    static std::thread writerThread;
+    static std::mutex queueMutex;
+    static std::condition_variable queueChanged;
+    static std::deque<PopulationChunk> queuedChunks;
+    static bool stopping;
+};
+
+#endif //ECOSIM_POPULATION_RECORDER_HPP
@@ -0,0 +1,79 @@
+#include "run_length_codec.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+const std::string RunLengthCodec::MAGIC = "ECOSIMRL";
+
+void RunLengthCodec::encode(const char *bytes, size_t length, std::string &output) {
+    // Bytes that are not part of an encoded run are copied in spans
+    size_t literalStart = 0;
+    size_t position = 0;
+    while (position < length) {
+        char runByte = bytes[position];
+        size_t runEnd = position + 1;
+        while (runEnd < length && bytes[runEnd] == runByte) {
+            runEnd++;
+        }
+
+        size_t runLength = runEnd - position;
+        if (runLength >= MIN_RUN_LENGTH || runByte == RUN_MARKER) {
+            output.append(bytes + literalStart, position - literalStart);
+            output += RUN_MARKER;
+            output += runByte;
+            for (; runLength >= 0x80; runLength >>= 7) {
+                output += (char) (0x80 | (runLength & 0x7F));
+            }
+            output += (char) runLength;
+            literalStart = runEnd;
+        }
+        position = runEnd;
+    }
+    output.append(bytes + literalStart, length - literalStart);
+}
+
+bool RunLengthCodec::decode(const char *bytes, size_t length, std::vector<char> &output) {
+    output.clear();
+    if (!isEncoded(bytes, length)) {
+        return false;
+    }
+
+    size_t position = MAGIC.size();
+    while (position < length) {
+        // Copy literal bytes up to the next run in one go
+        auto runStart = (const char *) memchr(bytes + position, RUN_MARKER, length - position);
+        size_t literalEnd = runStart ? (size_t) (runStart - bytes) : length;
+        output.insert(output.end(), bytes + position, bytes + literalEnd);
+        position = literalEnd;
+        if (position == length) {
+            break;
+        }
+
+        if (position + 2 >= length) {
+            return false;
+        }
+        char runByte = bytes[position + 1];
+        position += 2;
+        uint64_t runLength = 0;
+        for (int shift = 0;; shift += 7) {
+            if (position == length || shift > 56) {
+                return false;
+            }
+            auto lengthByte = (uint8_t) bytes[position++];
+            runLength |= (uint64_t) (lengthByte & 0x7F) << shift;
+            if ((lengthByte & 0x80) == 0) {
+                break;
+            }
+        }
+        // Rows hold at most INT32_MAX cells, so longer runs only come from corrupt data
+        if (runLength == 0 || runLength > INT32_MAX) {
+            return false;
+        }
+        output.insert(output.end(), runLength, runByte);
+    }
+    return true;
+}
+
+bool RunLengthCodec::isEncoded(const char *bytes, size_t length) {
+    return length >= MAGIC.size() && memcmp(bytes, MAGIC.data(), MAGIC.size()) == 0;
+}
@@ -0,0 +1,49 @@
+#ifndef ECOSIM_RUN_LENGTH_CODEC_HPP
+#define ECOSIM_RUN_LENGTH_CODEC_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Run-length codec for map files. Maps are mostly long runs of empty ground, water and plants, so replacing every
+ * run of a repeated character with the character and its length shrinks them considerably at almost no cost.
+ *
+ * Encoded data starts with MAGIC. After it every byte is copied as is except RUN_MARKER, which is followed by the
+ * repeated byte and the run length as a little-endian base-128 varint. Runs shorter than MIN_RUN_LENGTH are copied
+ * unless they repeat the marker itself
+ */
+class RunLengthCodec {
+public:
+    /**
+     * Encodes bytes and appends them to the output. Data may be encoded in pieces as long as no run is split
+     * between them, so a map can be encoded row by row
+     * @param bytes bytes to encode
+     * @param length number of bytes
+     * @param output encoded data is appended here, without MAGIC
+     */
+    static void encode(const char *bytes, size_t length, std::string &output);
+
+    /**
+     * Decodes data written by MAGIC and encode
+     * @param bytes encoded data starting with MAGIC
+     * @param length number of encoded bytes
+     * @param output replaced with the decoded bytes
+     * @return false if the data is not encoded or is corrupt
+     */
+    static bool decode(const char *bytes, size_t length, std::vector<char> &output);
+
+    /**
+     * Checks whether data starts with MAGIC
+     * @param bytes data to check
+     * @param length number of bytes
+     * @return true if the data is run-length encoded
+     */
+    static bool isEncoded(const char *bytes, size_t length);
+
+    static const std::string MAGIC;
+    static const char RUN_MARKER = '\0';
+    static const size_t MIN_RUN_LENGTH = 4;
+};
+
+#endif //ECOSIM_RUN_LENGTH_CODEC_HPP
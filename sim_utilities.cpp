@@ -3,59 +3,23 @@
 #include <sstream>
 #include <fstream>
 #include <iostream>
-#include "plant.hpp"
-#include "herbivore.hpp"
-#include "omnivore.hpp"
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "ncurses.h"
+#include "run_length_codec.hpp"
+#include "trace_recorder.hpp"
 
 namespace SimUtilities {
 #ifndef CURSES_DISABLED
 
-    void drawMap(WINDOW *window, const int mapOffsetY, const int mapOffsetX, bool has_border) {
-        // Clear the window
-        wclear(window);
-        // Redraw the border if present
-        if (has_border) {
-            wattron(window, COLOR_PAIR(1));
-            box(window, 0, 0);
-            wattroff(window, COLOR_PAIR(1));
-        }
-
-        // Cursor location entered in the form row, column (y, x)
-        // Draw terrain
-        for (auto &pointCharPair: MapManager::terrain) {
-            switch (pointCharPair.second) {
-                case '~' :
-                    // Water
-                    wattron(window, COLOR_PAIR(2));
-                    mvwaddch(window, pointCharPair.first.second + mapOffsetY, pointCharPair.first.first + mapOffsetX,
-                             '~');
-                    wattroff(window, COLOR_PAIR(2));
-                    break;
-                case '#':
-                    // Obstacle
-                    wattron(window, COLOR_PAIR(3));
-                    mvwaddch(window, pointCharPair.first.second + mapOffsetY, pointCharPair.first.first + mapOffsetX,
-                             '#');
-                    wattroff(window, COLOR_PAIR(3));
-                    break;
-                default:
-                    break;
-            }
-        }
-
-        // Draw plants and animals
-        for (auto &element: MapManager::floraFauna) {
-            wattron(window, COLOR_PAIR(element.second->getColorPair()));
-            mvwaddch(window, element.first.second + mapOffsetY, element.first.first + mapOffsetX,
-                     element.second->getCharID());
-            wattroff(window, COLOR_PAIR(element.second->getColorPair()));
-        }
-
-        wmove(window, 1, 1);
-        wrefresh(window);
-    }
-
     WINDOW *createWindow(int height, int width, int startY, int startX, bool addBorders) {
         auto local_win = newwin(height, width, startY, startX);
         // Add border around the window
@@ -153,134 +117,556 @@ namespace SimUtilities {
 
 #endif
 
-    unordered_map<char, SimUtilities::SpeciesTraits> loadSpeciesList(const string &speciesFilePath) {
-        ifstream speciesFile(speciesFilePath);
+    /**
+     * Parses the integer value following a command line switch, exiting with an error if it is missing or invalid
+     * @param argc argument count
+     * @param argv argument values
+     * @param argIndex index of the switch, advanced past the value
+     * @param minValue smallest accepted value
+     * @return parsed value
+     */
+    static int parseIntOption(int argc, char **argv, int &argIndex, int minValue) {
+        string optionName = argv[argIndex];
+        if (argIndex + 1 >= argc) {
+            cerr << "Missing value for option '" << optionName << "'" << endl;
+            exit(-1);
+        }
+
+        argIndex++;
+        try {
+            int value = stoi(argv[argIndex]);
+            if (value >= minValue) {
+                return value;
+            }
+        } catch (logic_error &invalidValue) {
+            // Falls through to the error below
+        }
+        cerr << "Invalid value '" << argv[argIndex] << "' for option '" << optionName << "'" << endl;
+        exit(-1);
+    }
+
+    /**
+     * Parses the seed following a command line switch, exiting with an error if it is missing or not an unsigned
+     * 64-bit integer. Every seed a run prints is accepted
+     * @param argc argument count
+     * @param argv argument values
+     * @param argIndex index of the switch, advanced past the value
+     * @return parsed seed
+     */
+    static uint64_t parseSeedOption(int argc, char **argv, int &argIndex) {
+        string optionName = argv[argIndex];
+        if (argIndex + 1 >= argc) {
+            cerr << "Missing value for option '" << optionName << "'" << endl;
+            exit(-1);
+        }
+
+        argIndex++;
+        string value = argv[argIndex];
+        try {
+            // stoull would wrap negative values around instead of rejecting them
+            size_t parsedLength = 0;
+            uint64_t seed = stoull(value, &parsedLength);
+            if (value.find('-') == string::npos && parsedLength == value.size()) {
+                return seed;
+            }
+        } catch (logic_error &invalidValue) {
+            // Falls through to the error below
+        }
+        cerr << "Invalid value '" << value << "' for option '" << optionName << "'" << endl;
+        exit(-1);
+    }
+
+    /**
+     * Returns the value following a command line switch, exiting with an error if it is missing
+     * @param argc argument count
+     * @param argv argument values
+     * @param argIndex index of the switch, advanced past the value
+     * @return option value
+     */
+    static string parseStringOption(int argc, char **argv, int &argIndex) {
+        if (argIndex + 1 >= argc) {
+            cerr << "Missing value for option '" << argv[argIndex] << "'" << endl;
+            exit(-1);
+        }
+        argIndex++;
+        return argv[argIndex];
+    }
+
+    SimOptions parseOptions(int argc, char **argv) {
+        SimOptions options;
+        vector<string> positionalArgs;
+        bool hasSeed = false;
+        bool hasTicks = false;
+
+        for (int argIndex = 1; argIndex < argc; argIndex++) {
+            string arg = argv[argIndex];
+            if (arg == "--threads") {
+                // Zero selects one thread per hardware thread
+                options.threadCount = parseIntOption(argc, argv, argIndex, 0);
+                if (options.threadCount == 0) {
+                    options.threadCount = max(1, (int) thread::hardware_concurrency());
+                }
+            } else if (arg == "--scaling-report") {
+                options.scalingReportTicks = parseIntOption(argc, argv, argIndex, 1);
+            } else if (arg == "--headless") {
+                options.headless = true;
+            } else if (arg == "--ticks") {
+                options.headlessTicks = parseIntOption(argc, argv, argIndex, 0);
+                hasTicks = true;
+            } else if (arg == "--fps") {
+                options.framesPerSecond = parseIntOption(argc, argv, argIndex, 1);
+            } else if (arg == "--tick-delay") {
+                options.tickDelayMillis = parseIntOption(argc, argv, argIndex, 0);
+            } else if (arg == "--trace") {
+                options.traceFilePath = parseStringOption(argc, argv, argIndex);
+            } else if (arg == "--tick-stats") {
+                options.tickStatsFilePath = parseStringOption(argc, argv, argIndex);
+            } else if (arg == "--resume") {
+                options.resumeFilePath = parseStringOption(argc, argv, argIndex);
+            } else if (arg == "--save-checkpoint") {
+                options.saveCheckpointFilePath = parseStringOption(argc, argv, argIndex);
+            } else if (arg == "--save-map") {
+                options.saveMapFilePath = parseStringOption(argc, argv, argIndex);
+            } else if (arg == "--population") {
+                options.populationFilePath = parseStringOption(argc, argv, argIndex);
+            } else if (arg == "--population-csv") {
+                options.populationCsvFilePath = parseStringOption(argc, argv, argIndex);
+            } else if (arg == "--record-actions") {
+                options.recordActionsFilePath = parseStringOption(argc, argv, argIndex);
+            } else if (arg == "--keyframe-interval") {
+                options.keyframeInterval = parseIntOption(argc, argv, argIndex, 0);
+            } else if (arg == "--replay") {
+                options.replayFilePath = parseStringOption(argc, argv, argIndex);
+            } else if (arg == "--replay-to") {
+                options.replayToTick = parseIntOption(argc, argv, argIndex, 0);
+            } else if (arg == "--ensemble") {
+                options.ensembleReplicas = parseIntOption(argc, argv, argIndex, 1);
+            } else if (arg == "--ensemble-species") {
+                options.ensembleSpeciesFilePaths.push_back(parseStringOption(argc, argv, argIndex));
+            } else if (arg == "--seed") {
+                options.seed = parseSeedOption(argc, argv, argIndex);
+                hasSeed = true;
+            } else if (arg.rfind("--", 0) == 0) {
+                cerr << "Unknown option '" << arg << "'" << endl;
+                exit(-1);
+            } else {
+                positionalArgs.push_back(arg);
+            }
+        }
+
+        if (hasTicks && !options.headless && options.ensembleReplicas == 0) {
+            cerr << "Option '--ticks' is only valid together with '--headless' or '--ensemble'" << endl;
+            exit(-1);
+        }
+        if (!options.ensembleSpeciesFilePaths.empty() && options.ensembleReplicas == 0) {
+            cerr << "Option '--ensemble-species' is only valid together with '--ensemble'" << endl;
+            exit(-1);
+        }
+        if (!options.populationCsvFilePath.empty() && options.populationFilePath.empty()) {
+            cerr << "Option '--population-csv' is only valid together with '--population'" << endl;
+            exit(-1);
+        }
+        if (options.keyframeInterval >= 0 && options.recordActionsFilePath.empty()) {
+            cerr << "Option '--keyframe-interval' is only valid together with '--record-actions'" << endl;
+            exit(-1);
+        }
+        if (options.replayToTick >= 0 && options.replayFilePath.empty()) {
+            cerr << "Option '--replay-to' is only valid together with '--replay'" << endl;
+            exit(-1);
+        }
+        if (!hasSeed) {
+            options.seed = random_device{}();
+        }
+
+        // Set default map and species files if none are specified
+        if (positionalArgs.size() >= 2) {
+            options.mapFilePath = positionalArgs[0];
+            options.speciesFilePath = positionalArgs[1];
+        }
+
+        return options;
+    }
+
+    vector<size_t> speciesPopulations() {
+        vector<size_t> populations(MapManager::species().size(), 0);
+        for (size_t index = 0; index < populations.size(); index++) {
+            populations[index] = MapManager::entities().countOf((SpeciesIndex) index);
+        }
+        return populations;
+    }
+
+    void printRunSummary(ostream &outputStream, long ticks, double seconds) {
+        outputStream << "Ran " << ticks << " ticks in " << fixed << setprecision(3) << seconds << " seconds ("
+                     << setprecision(1) << ticks / max(seconds, 1e-9) << " ticks/sec)" << endl;
+
+        vector<size_t> populations = speciesPopulations();
+        for (size_t index = 0; index < populations.size(); index++) {
+            const Species &species = MapManager::species()[(SpeciesIndex) index];
+            const char *typeName = species.speciesType == SpeciesType::PLANT ? "plant" :
+                                   species.speciesType == SpeciesType::HERBIVORE ? "herbivore" : "omnivore";
+            EntityStore::PoolStats pool = MapManager::entities().poolStats((SpeciesIndex) index);
+            outputStream << "  " << species.charID << " (" << typeName << "): " << populations[index]
+                         << ", pool high water " << pool.highWater << " of " << pool.capacity << " slots" << endl;
+        }
+    }
+
+    bool parseSpeciesList(istream &speciesStream, SpeciesTable &speciesList) {
         istringstream stringTraitStream;
         string traitString, fileLine;
-        unordered_map<char, SimUtilities::SpeciesTraits> speciesList;
-
-        if (speciesFile.is_open()) {
-            while (getline(speciesFile, fileLine)) {
-                stringTraitStream.clear();
-                stringTraitStream.str(fileLine);
-                string speciesType;
-                char speciesID;
-                vector<char> foodChain;
-                int regrowthCoeff = -1;
-                int energy = -1;
-
-                // Read the species type
-                stringTraitStream >> traitString;
-                speciesType = traitString;
-                transform(speciesType.begin(), speciesType.end(), speciesType.begin(), ::tolower);
-                // Read the character ID
+
+        while (getline(speciesStream, fileLine)) {
+            stringTraitStream.clear();
+            stringTraitStream.str(fileLine);
+            string speciesType;
+            char speciesID;
+            vector<char> foodChain;
+            int regrowthCoeff = -1;
+            int energy = -1;
+
+            // Read the species type
+            stringTraitStream >> traitString;
+            speciesType = traitString;
+            transform(speciesType.begin(), speciesType.end(), speciesType.begin(), ::tolower);
+            // Read the character ID
+            stringTraitStream >> traitString;
+            speciesID = traitString[0];
+
+            // Read the rest of the traits
+            do {
                 stringTraitStream >> traitString;
-                speciesID = traitString[0];
-
-                // Read the rest of the traits
-                do {
-                    stringTraitStream >> traitString;
-
-                    // Assemble food chain
-                    if (traitString.find('[') != string::npos || traitString.find(']') != string::npos ||
-                        traitString.find(',') != string::npos) {
-                        traitString.erase(std::remove(traitString.begin(), traitString.end(), '['), traitString.end());
-                        traitString.erase(std::remove(traitString.begin(), traitString.end(), ']'), traitString.end());
-                        traitString.erase(std::remove(traitString.begin(), traitString.end(), ','), traitString.end());
-                        foodChain.push_back(traitString[0]);
-                        continue;
-                    }
 
-                    // Set regrowth coefficient for plants and maximum energy levels for both plants and animals
-                    if (speciesType == "plant") {
-                        if (regrowthCoeff == -1) {
-                            regrowthCoeff = stoi(traitString);
-                        } else if (energy == -1) {
-                            energy = stoi(traitString);
-                        }
-                    } else {
+                // Assemble food chain
+                if (traitString.find('[') != string::npos || traitString.find(']') != string::npos ||
+                    traitString.find(',') != string::npos) {
+                    traitString.erase(std::remove(traitString.begin(), traitString.end(), '['), traitString.end());
+                    traitString.erase(std::remove(traitString.begin(), traitString.end(), ']'), traitString.end());
+                    traitString.erase(std::remove(traitString.begin(), traitString.end(), ','), traitString.end());
+                    foodChain.push_back(traitString[0]);
+                    continue;
+                }
+
+                // Set regrowth coefficient for plants and maximum energy levels for both plants and animals
+                if (speciesType == "plant") {
+                    if (regrowthCoeff == -1) {
+                        regrowthCoeff = stoi(traitString);
+                    } else if (energy == -1) {
                         energy = stoi(traitString);
                     }
+                } else {
+                    energy = stoi(traitString);
+                }
 
-                } while (stringTraitStream);
+            } while (stringTraitStream);
 
-                // Add species definition to the reference map
-                speciesList.insert(
-                        pair<char, SimUtilities::SpeciesTraits>(speciesID, {speciesType, regrowthCoeff, energy,
-                                                                            foodChain}));
+            // Add species definition to the species table
+            if (speciesList.indexOf(speciesID) == -1 && speciesList.size() >= SpeciesTable::MAX_SPECIES) {
+                return false;
             }
-            speciesFile.close();
-        } else {
+            if (speciesType == "plant") {
+                speciesList.add({speciesID, SpeciesType::PLANT, regrowthCoeff, energy, 1, foodChain});
+            } else if (speciesType == "herbivore") {
+                speciesList.add({speciesID, SpeciesType::HERBIVORE, regrowthCoeff, energy, 4, foodChain});
+            } else if (speciesType == "omnivore") {
+                speciesList.add({speciesID, SpeciesType::OMNIVORE, regrowthCoeff, energy, 5, foodChain});
+            }
+        }
+        return true;
+    }
+
+    SpeciesTable loadSpeciesList(const string &speciesFilePath) {
+        ifstream speciesFile(speciesFilePath);
+        if (!speciesFile.is_open()) {
             cerr << "Unable to open file '" << speciesFilePath << "'" << endl;
             exit(-1);
         }
 
+        SpeciesTable speciesList;
+        if (!parseSpeciesList(speciesFile, speciesList)) {
+            cerr << "Too many species in '" << speciesFilePath << "', at most " << SpeciesTable::MAX_SPECIES
+                 << " are supported" << endl;
+            exit(-1);
+        }
         return speciesList;
     }
 
-    void loadMap(const string &mapFilePath, const unordered_map<char, SimUtilities::SpeciesTraits> &speciesList) {
-        int xPos = 0;
-        int yPos = 0;
-        int mapColumns = 0;
-        ifstream mapFile(mapFilePath);
-        string fileLine;
-
-        if (mapFile.is_open()) {
-            while (getline(mapFile, fileLine)) {
-                xPos = 0;
-                for (char mapChar : fileLine) {
-                    Point location(xPos, yPos);
-                    if (mapChar == '~' || mapChar == '#') {
-                        // Terrain element
-                        MapManager::terrain.insert(pair(location, mapChar));
-                    } else if (mapChar != ' ') {
-                        // Flora or fauna element
-                        auto foundSpeciesType = speciesList.find(mapChar)->second;
-
-                        if (foundSpeciesType.speciesType == "plant") {
-                            MapManager::floraFauna.insert(
-                                    pair(location, make_unique<Plant>(mapChar, location, foundSpeciesType.regrowthCoeff,
-                                                                      foundSpeciesType.energy)));
-                        } else if (foundSpeciesType.speciesType == "herbivore") {
-                            MapManager::floraFauna.insert(
-                                    pair(location, make_unique<Herbivore>(mapChar, location, foundSpeciesType.foodChain,
-                                                                          foundSpeciesType.energy)));
-                        } else if (foundSpeciesType.speciesType == "omnivore") {
-                            MapManager::floraFauna.insert(
-                                    pair(location, make_unique<Omnivore>(mapChar, location, foundSpeciesType.foodChain,
-                                                                         foundSpeciesType.energy)));
-                        }
-
-                    }
-                    xPos++;
+    // Cell codes other than a species index
+    static const int16_t EMPTY_CELL = -1;
+    static const int16_t UNKNOWN_CELL = -2;
+    static const int16_t TERRAIN_CELL = -3;
+
+    // Rows classified by one loader task
+    static const size_t LOAD_ROWS_PER_TASK = 256;
+
+    /**
+     * Plants, animals and terrain found in a block of rows, in row-major order
+     */
+    struct LoadBatch {
+        vector<pair<size_t, SpeciesIndex>> elements;
+        vector<pair<size_t, TerrainType>> terrainCells;
+        vector<size_t> speciesCounts;
+        // First unknown character of the block, if any
+        size_t errorRow = 0;
+        size_t errorColumn = 0;
+        char errorChar = 0;
+        bool hasError = false;
+    };
+
+    /**
+     * Characters of a map file, either straight from its mapping or decoded
+     */
+    struct MapText {
+        const char *bytes = nullptr;
+        size_t length = 0;
+    };
+
+    /**
+     * Read-only memory mapping of a whole file, unmapped when it goes out of scope
+     */
+    class MappedFile {
+    public:
+        explicit MappedFile(const string &filePath) {
+            int fileDescriptor = open(filePath.c_str(), O_RDONLY);
+            if (fileDescriptor == -1) {
+                return;
+            }
+            struct stat fileStatus{};
+            if (fstat(fileDescriptor, &fileStatus) == 0 && S_ISREG(fileStatus.st_mode)) {
+                length = (size_t) fileStatus.st_size;
+                isOpen = true;
+                if (length > 0) {
+                    void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+                    isOpen = mapping != MAP_FAILED;
+                    bytes = isOpen ? (const char *) mapping : nullptr;
                 }
-                mapColumns = max(mapColumns, xPos);
-                yPos++;
             }
+            close(fileDescriptor);
+        }
+
+        ~MappedFile() {
+            if (bytes != nullptr) {
+                munmap((void *) bytes, length);
+            }
+        }
 
-            MapManager::mapRows = yPos;
-            MapManager::mapColumns = mapColumns;
+        MappedFile(const MappedFile &) = delete;
 
-            cout << "Map with " << MapManager::mapRows << " rows and " << MapManager::mapColumns << " columns loaded"
-                 << endl;
+        MappedFile &operator=(const MappedFile &) = delete;
 
-            mapFile.close();
+        const char *bytes = nullptr;
+        size_t length = 0;
+        bool isOpen = false;
+    };
+
+    /**
+     * Runs every task on the pool, or inline without one
+     */
+    static void runTasks(ThreadPool *pool, size_t taskCount, const function<void(size_t)> &task) {
+        if (pool) {
+            pool->run(taskCount, task);
         } else {
+            for (size_t taskIndex = 0; taskIndex < taskCount; taskIndex++) {
+                task(taskIndex);
+            }
+        }
+    }
+
+    /**
+     * Finds the start of every line of the file. Each task scans its own byte range for line breaks, so the lines
+     * of a large file are found in parallel
+     * @param mapText characters of the map file
+     * @param pool pool to scan on, may be null
+     * @return offsets of every line start followed by the offset just past the last line
+     */
+    static vector<size_t> findLineStarts(const MapText &mapText, ThreadPool *pool) {
+        size_t rangeCount = pool ? (size_t) pool->getWorkerCount() * 4 : 1;
+        size_t rangeLength = mapText.length / rangeCount + 1;
+        vector<vector<size_t>> rangeBreaks(rangeCount);
+        runTasks(pool, rangeCount, [&](size_t range) {
+            size_t position = min(mapText.length, range * rangeLength);
+            size_t rangeEnd = min(mapText.length, position + rangeLength);
+            while (position < rangeEnd) {
+                auto lineBreak = (const char *) memchr(mapText.bytes + position, '\n', rangeEnd - position);
+                if (lineBreak == nullptr) {
+                    break;
+                }
+                position = lineBreak - mapText.bytes + 1;
+                rangeBreaks[range].push_back(position);
+            }
+        });
+
+        // Like getline, a final line break does not start another line
+        vector<size_t> lineStarts = {0};
+        for (const vector<size_t> &breaks: rangeBreaks) {
+            lineStarts.insert(lineStarts.end(), breaks.begin(), breaks.end());
+        }
+        if (lineStarts.back() != mapText.length) {
+            lineStarts.push_back(mapText.length);
+        }
+        return lineStarts;
+    }
+
+    /**
+     * Returns the length of a line without its line break, also dropping the carriage return of CRLF files
+     */
+    static size_t lineLengthOf(const MapText &mapText, const vector<size_t> &lineStarts, size_t row) {
+        size_t lineEnd = lineStarts[row + 1];
+        if (lineEnd > lineStarts[row] && mapText.bytes[lineEnd - 1] == '\n') {
+            lineEnd--;
+        }
+        if (lineEnd > lineStarts[row] && mapText.bytes[lineEnd - 1] == '\r') {
+            lineEnd--;
+        }
+        return lineEnd - lineStarts[row];
+    }
+
+    /**
+     * Sorts the cells of a block of rows into elements and terrain, skipping runs of empty cells eight at a time
+     * @param mapText characters of the map file
+     * @param lineStarts line offsets from findLineStarts
+     * @param cellCodes code of every character
+     * @param columns width of the map
+     * @param firstRow first row of the block
+     * @param lastRow row just past the block
+     * @param batch batch to fill
+     */
+    static void classifyRows(const MapText &mapText, const vector<size_t> &lineStarts,
+                             const array<int16_t, 256> &cellCodes, size_t columns, size_t firstRow, size_t lastRow,
+                             LoadBatch &batch) {
+        const uint64_t ALL_SPACES = 0x2020202020202020;
+        for (size_t row = firstRow; row < lastRow && !batch.hasError; row++) {
+            const char *line = mapText.bytes + lineStarts[row];
+            size_t lineLength = lineLengthOf(mapText, lineStarts, row);
+            size_t column = 0;
+            while (column < lineLength) {
+                uint64_t eightCells;
+                if (column + 8 <= lineLength && (memcpy(&eightCells, line + column, 8), eightCells == ALL_SPACES)) {
+                    column += 8;
+                    continue;
+                }
+
+                int16_t cellCode = cellCodes[(unsigned char) line[column]];
+                size_t cellIndex = row * columns + column;
+                if (cellCode >= 0) {
+                    batch.elements.emplace_back(cellIndex, (SpeciesIndex) cellCode);
+                    batch.speciesCounts[cellCode]++;
+                } else if (cellCode == TERRAIN_CELL) {
+                    batch.terrainCells.emplace_back(cellIndex, TerrainRaster::fromChar(line[column]));
+                } else if (cellCode == UNKNOWN_CELL) {
+                    batch.errorRow = row;
+                    batch.errorColumn = column;
+                    batch.errorChar = line[column];
+                    batch.hasError = true;
+                    break;
+                }
+                column++;
+            }
+        }
+    }
+
+    bool loadMapFromMemory(const char *mapBytes, size_t mapLength, const SpeciesTable &speciesList, int threadCount,
+                           string &errorMessage) {
+        TraceSpan loadSpan("loadMap");
+        unique_ptr<ThreadPool> pool = threadCount > 1 ? make_unique<ThreadPool>(threadCount) : nullptr;
+
+        MapText mapText{mapBytes, mapLength};
+        vector<char> decodedMap;
+        if (RunLengthCodec::isEncoded(mapBytes, mapLength)) {
+            if (!RunLengthCodec::decode(mapBytes, mapLength, decodedMap)) {
+                errorMessage = "Corrupt compressed map";
+                return false;
+            }
+            mapText = {decodedMap.data(), decodedMap.size()};
+        }
+
+        vector<size_t> lineStarts = mapText.length > 0 ? findLineStarts(mapText, pool.get()) : vector<size_t>{0};
+        size_t rows = lineStarts.size() - 1;
+        size_t columns = 0;
+        for (size_t row = 0; row < rows; row++) {
+            columns = max(columns, lineLengthOf(mapText, lineStarts, row));
+        }
+
+        // Terrain takes precedence over a species using the same character
+        array<int16_t, 256> cellCodes{};
+        cellCodes.fill(UNKNOWN_CELL);
+        for (size_t index = 0; index < speciesList.size(); index++) {
+            cellCodes[(unsigned char) speciesList[(SpeciesIndex) index].charID] = (int16_t) index;
+        }
+        cellCodes[(unsigned char) ' '] = EMPTY_CELL;
+        cellCodes[(unsigned char) '~'] = TERRAIN_CELL;
+        cellCodes[(unsigned char) '#'] = TERRAIN_CELL;
+
+        vector<LoadBatch> batches((rows + LOAD_ROWS_PER_TASK - 1) / LOAD_ROWS_PER_TASK);
+        runTasks(pool.get(), batches.size(), [&](size_t batchIndex) {
+            size_t firstRow = batchIndex * LOAD_ROWS_PER_TASK;
+            batches[batchIndex].speciesCounts.resize(speciesList.size());
+            classifyRows(mapText, lineStarts, cellCodes, columns, firstRow, min(rows, firstRow + LOAD_ROWS_PER_TASK),
+                         batches[batchIndex]);
+        });
+
+        vector<size_t> speciesCounts(speciesList.size());
+        for (const LoadBatch &batch: batches) {
+            if (batch.hasError) {
+                errorMessage = "Unknown species character '" + string(1, batch.errorChar) + "' at row " +
+                               to_string(batch.errorRow + 1) + ", column " + to_string(batch.errorColumn + 1);
+                return false;
+            }
+            for (size_t index = 0; index < speciesCounts.size(); index++) {
+                speciesCounts[index] += batch.speciesCounts[index];
+            }
+        }
+
+        // Elements are created in row-major order, so ids do not depend on the number of loader threads
+        MapManager::resetWorld((int) rows, (int) columns);
+        MapManager::species() = speciesList;
+        MapManager::entities().reserve(speciesCounts);
+        for (const LoadBatch &batch: batches) {
+            for (const auto &terrainCell: batch.terrainCells) {
+                MapManager::terrain().set(Point((int) (terrainCell.first % columns),
+                                                (int) (terrainCell.first / columns)), terrainCell.second);
+            }
+            for (const auto &element: batch.elements) {
+                Point location((int) (element.first % columns), (int) (element.first / columns));
+                MapManager::entities().create(element.second, location, speciesList[element.second].energy);
+            }
+        }
+
+        // Both buffers start out identical
+        MapManager::entities().clearChanges();
+        MapManager::nextEntities() = MapManager::entities();
+        MapManager::floraFauna().rebuildFrom(MapManager::entities(), MapManager::species());
+        MapManager::nextFloraFauna().rebuildFrom(MapManager::entities(), MapManager::species());
+        return true;
+    }
+
+    void loadMap(const string &mapFilePath, const SpeciesTable &speciesList, int threadCount) {
+        MappedFile mapFile(mapFilePath);
+        if (!mapFile.isOpen) {
             cerr << "Unable to open file '" << mapFilePath << "'" << endl;
             exit(-1);
         }
+        string errorMessage;
+        if (!loadMapFromMemory(mapFile.bytes, mapFile.length, speciesList, threadCount, errorMessage)) {
+            cerr << errorMessage << " in '" << mapFilePath << "'" << endl;
+            exit(-1);
+        }
+
+        cout << "Map with " << MapManager::mapRows() << " rows and " << MapManager::mapColumns() << " columns loaded"
+             << endl;
     }
 
-    std::vector<Point> randomSelect(const std::vector<Point> &locations, size_t count) {
-        vector<Point> selection;
-        std::sample(locations.begin(), locations.end(), std::back_inserter(selection),
-                    count, mt19937{random_device{}()});
-        return selection;
+    Point randomPick(const NeighborCells &cells, CounterRng &rng) {
+        // Selection sampling rather than std::sample, whose draws differ between standard library implementations
+        size_t remaining = cells.size();
+        for (const Point &cell: cells) {
+            if (rng.below(remaining) == 0) {
+                return cell;
+            }
+            remaining--;
+        }
+        return cells[cells.size() - 1];
     }
 
-    double getValUniformRandDist() {
-        mt19937::result_type seed = time(0);
-        auto realRand = bind(uniform_real_distribution<double>(0, 1), mt19937(seed));
-        return realRand();
+    double getValUniformRandDist(CounterRng &rng) {
+        return rng.uniform();
     }
 }
@@ -1,33 +1,126 @@
 #ifndef ECOSIM_SIM_UTILITIES_HPP
 #define ECOSIM_SIM_UTILITIES_HPP
 
+#include <istream>
+#include <ostream>
 #include <string>
 #include <random>
 #include <iterator>
-#include <map>
-#include <unordered_map>
-#include "ecosystem_element.hpp"
+#include <vector>
+#include "ncurses.h"
+#include "entity_store.hpp"
+#include "species_table.hpp"
 #include "map_manager.hpp"
+#include "counter_rng.hpp"
 
 namespace SimUtilities {
 
-    struct SpeciesTraits {
-    public:
-        string speciesType;
-        int regrowthCoeff;
-        int energy;
-        vector<char> foodChain;
+    /**
+     * Command line options for a simulation run
+     */
+    struct SimOptions {
+        string mapFilePath = "default_input/map.txt";
+        string speciesFilePath = "default_input/species.txt";
+        int threadCount = 1;
+        int scalingReportTicks = 0;
+        // Drawn from the system entropy source unless given with --seed
+        uint64_t seed = 0;
+        bool headless = false;
+        int headlessTicks = 100;
+        // Rate at which the interactive view draws the newest frame
+        int framesPerSecond = 30;
+        // Pause after every interactive tick so individual ticks can be followed, the simulation is not paced
+        // otherwise
+        int tickDelayMillis = 0;
+        // Per-tick instrumentation is written here at exit when set
+        string tickStatsFilePath;
+        // Spans of every thread are recorded and written here as a Chrome trace at exit when set
+        string traceFilePath;
+        // Checkpoint to continue from instead of loading the map and species files
+        string resumeFilePath;
+        // A checkpoint of the final state is written here at exit when set
+        string saveCheckpointFilePath;
+        // The final map is written here at exit when set, run-length encoded if it ends in .rle
+        string saveMapFilePath;
+        // Per-tick population time series of every species are recorded here when set
+        string populationFilePath;
+        // The population recording is also exported as CSV here at exit when set
+        string populationCsvFilePath;
+        // Every state change of the run is logged here when set
+        string recordActionsFilePath;
+        // Ticks between keyframes of the action log, the action log's default interval when negative
+        int keyframeInterval = -1;
+        // Action log replayed onto the loaded world before the run continues
+        string replayFilePath;
+        // Tick the replay stops at, the whole log is replayed when negative
+        int replayToTick = -1;
+        // Number of replicas of the loaded world to run for every species variant, no ensemble is run when 0
+        int ensembleReplicas = 0;
+        // Species files whose constants override the loaded species in further ensemble variants
+        vector<string> ensembleSpeciesFilePaths;
     };
 
-    void drawMap(WINDOW *window, const int mapOffsetY, const int mapOffsetX, bool has_border);
+    /**
+     * Parses the command line. The map and species filepaths are positional and both have to be given to replace
+     * the defaults, every other option is a named switch followed by its value. Exits on invalid options
+     * @param argc argument count
+     * @param argv argument values
+     * @return parsed options
+     */
+    SimOptions parseOptions(int argc, char **argv);
+
+    /**
+     * Counts the living elements of every species in the committed state
+     * @return populations indexed by species index
+     */
+    vector<size_t> speciesPopulations();
+
+    /**
+     * Prints the tick count, wall time and throughput of a finished run, along with the final population and pool
+     * usage of every species
+     * @param outputStream stream to print the summary to
+     * @param ticks number of ticks that were run
+     * @param seconds wall time the ticks took
+     */
+    void printRunSummary(ostream &outputStream, long ticks, double seconds);
 
     WINDOW *createWindow(int height, int width, int startY, int startX, bool addBorders);
 
     void destroyWindow(WINDOW *local_win);
 
-    unordered_map<char, SimUtilities::SpeciesTraits> loadSpeciesList(const string &speciesFilePath);
+    /**
+     * Reads species definitions in the format of species files, one species per line
+     * @param speciesStream definitions to read
+     * @param speciesList table to add the species to
+     * @return false if there are more species than a table can hold
+     */
+    bool parseSpeciesList(istream &speciesStream, SpeciesTable &speciesList);
+
+    SpeciesTable loadSpeciesList(const string &speciesFilePath);
+
+    /**
+     * Builds the world from the characters of a map held in memory, exactly like loadMap does from a file but
+     * reporting errors instead of exiting
+     * @param mapBytes characters of the map, run-length encoded maps are decoded first
+     * @param mapLength number of bytes in mapBytes
+     * @param speciesList species the map's characters refer to
+     * @param threadCount number of threads used to scan the map
+     * @param errorMessage set to the reason the map was rejected
+     * @return false if the map is corrupt or holds an unknown character, the world is left untouched then
+     */
+    bool loadMapFromMemory(const char *mapBytes, size_t mapLength, const SpeciesTable &speciesList, int threadCount,
+                           string &errorMessage);
 
-    void loadMap(const string &mapFilePath, const unordered_map<char, SimUtilities::SpeciesTraits> &speciesList);
+    /**
+     * Loads a map file into the world. The file is memory mapped, its rows are found and classified in parallel and
+     * the world is built from the classified cells in one pass. Exits if the file cannot be read or holds a
+     * character that is neither terrain nor a known species. Run-length encoded maps written by
+     * MapManager::saveMapToFile are decoded first
+     * @param mapFilePath filepath of the map
+     * @param speciesList species the map's characters refer to
+     * @param threadCount number of threads used to scan the file
+     */
+    void loadMap(const string &mapFilePath, const SpeciesTable &speciesList, int threadCount = 1);
 
     void windowPrintString(WINDOW *window, const char *printString, bool has_border);
 
@@ -35,9 +128,15 @@ namespace SimUtilities {
 
     string windowPromptStr(WINDOW *window, const char *promptString, vector<string> &allowedValues, int bufferSize);
 
-    std::vector<Point> randomSelect(const std::vector<Point> &locations, size_t count);
+    /**
+     * Picks one of the cells a neighbor query matched at random
+     * @param cells cells to pick from, at least one
+     * @param rng generator of the element doing the picking
+     * @return picked cell
+     */
+    Point randomPick(const NeighborCells &cells, CounterRng &rng);
 
-    double getValUniformRandDist();
+    double getValUniformRandDist(CounterRng &rng);
 }
 
 #endif //ECOSIM_SIM_UTILITIES_HPP
\ No newline at end of file
@@ -0,0 +1,28 @@
+#include "species_table.hpp"
+
+SpeciesIndex SpeciesTable::add(const Species &speciesToAdd) {
+    int existingIndex = indexOf(speciesToAdd.charID);
+    if (existingIndex != -1) {
+        species[existingIndex] = speciesToAdd;
+        compilePredation();
+        return (SpeciesIndex) existingIndex;
+    }
+
+    species.push_back(speciesToAdd);
+    charLookup[(unsigned char) speciesToAdd.charID] = (int16_t) (species.size() - 1);
+    compilePredation();
+    return (SpeciesIndex) (species.size() - 1);
+}
+
+void SpeciesTable::compilePredation() {
+    // Food chains may name species that were added after the predator, so every row is rebuilt
+    predation.assign(species.size(), PreyMask{});
+    for (size_t predator = 0; predator < species.size(); predator++) {
+        for (char preyID: species[predator].foodChain) {
+            int prey = indexOf(preyID);
+            if (prey != -1) {
+                predation[predator][prey / 64] |= (uint64_t) 1 << (prey % 64);
+            }
+        }
+    }
+}
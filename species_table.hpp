@@ -0,0 +1,84 @@
+#ifndef ECOSIM_SPECIES_TABLE_HPP
+#define ECOSIM_SPECIES_TABLE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "species_type.hpp"
+
+using SpeciesIndex = uint8_t;
+
+/**
+ * Constants shared by every member of a species, stored once in the species table instead of on each element
+ */
+struct Species {
+    char charID;
+    SpeciesType speciesType;
+    int regrowthCoeff;
+    int energy;
+    short colorPair;
+    std::vector<char> foodChain;
+};
+
+/**
+ * Dense table of every species in the scenario. Species are referred to by their index into the table, which is
+ * what the entity store keeps for each element.
+ *
+ * Food chains are compiled into a predator-by-prey bit matrix whenever a species is added, so checking whether one
+ * species can eat another is a single bit test
+ */
+class SpeciesTable {
+public:
+    SpeciesTable() { charLookup.fill(-1); }
+
+    /**
+     * Adds a species to the table, replacing an existing definition with the same character ID
+     * @param speciesToAdd species definition
+     * @return index of the species in the table
+     */
+    SpeciesIndex add(const Species &speciesToAdd);
+
+    /**
+     * Looks up the index of the species with the given character ID
+     * @param charID character used for the species on the map
+     * @return species index or -1 if the character is not a known species
+     */
+    int indexOf(char charID) const { return charLookup[(unsigned char) charID]; }
+
+    /**
+     * Checks whether the predator species has the prey species in its food chain
+     * @param predator index of the species doing the eating
+     * @param prey index of the species to be eaten
+     * @return true if the prey is edible to the predator
+     */
+    bool canEat(SpeciesIndex predator, SpeciesIndex prey) const {
+        return (predation[predator][prey / 64] >> (prey % 64)) & 1;
+    }
+
+    const Species &operator[](SpeciesIndex index) const { return species[index]; }
+
+    size_t size() const { return species.size(); }
+
+    bool empty() const { return species.empty(); }
+
+    // Every species index fits in a SpeciesIndex
+    static const size_t MAX_SPECIES = 256;
+
+private:
+    using PreyMask = std::array<uint64_t, MAX_SPECIES / 64>;
+
+    /**
+     * Rebuilds the predation matrix from the food chains. Food chain entries that are not a known species are
+     * ignored until a species with that character ID is added
+     */
+    void compilePredation();
+
+    std::vector<Species> species;
+    // One row of prey bits per predator species
+    std::vector<PreyMask> predation;
+    std::array<int16_t, 256> charLookup;
+};
+
+#endif //ECOSIM_SPECIES_TABLE_HPP
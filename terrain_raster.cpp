@@ -0,0 +1,13 @@
+#include "terrain_raster.hpp"
+
+void TerrainRaster::reset(int rows, int columns) {
+    this->rows = rows;
+    this->columns = columns;
+    packedCells.assign(((size_t) rows * columns + 3) / 4, 0);
+}
+
+void TerrainRaster::set(const Point &location, TerrainType terrainType) {
+    size_t index = cellIndex(location);
+    int shift = (int) (index & 3) << 1;
+    packedCells[index >> 2] = (uint8_t) ((packedCells[index >> 2] & ~(3 << shift)) | (terrainType << shift));
+}
@@ -0,0 +1,104 @@
+#ifndef ECOSIM_TERRAIN_RASTER_HPP
+#define ECOSIM_TERRAIN_RASTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "entity_store.hpp"
+#include "binary_io.hpp"
+
+enum TerrainType : uint8_t {
+    OPEN_GROUND = 0, WATER = 1, OBSTACLE = 2
+};
+
+/**
+ * Packed terrain map storing 2 bits per cell in row-major order. Open ground is stored as zero so a passability
+ * check is a single byte load and mask
+ */
+class TerrainRaster {
+public:
+    /**
+     * Resizes the raster to the given dimensions with every cell set to open ground
+     * @param rows number of rows in the map
+     * @param columns number of columns in the map
+     */
+    void reset(int rows, int columns);
+
+    /**
+     * Sets the terrain type of a single cell
+     * @param location point location of the cell
+     * @param terrainType terrain to store in the cell
+     */
+    void set(const Point &location, TerrainType terrainType);
+
+    TerrainType get(const Point &location) const {
+        size_t index = cellIndex(location);
+        return (TerrainType) ((packedCells[index >> 2] >> ((index & 3) << 1)) & 3);
+    }
+
+    bool isPassable(const Point &location) const {
+        size_t index = cellIndex(location);
+        return ((packedCells[index >> 2] >> ((index & 3) << 1)) & 3) == OPEN_GROUND;
+    }
+
+    /**
+     * Visits every water and obstacle cell in row-major order, skipping fully open bytes four cells at a time
+     * @param visitor callable taking the cell location and its terrain type
+     */
+    template<typename Visitor>
+    void forEachTerrain(Visitor &&visitor) const {
+        for (size_t byteIndex = 0; byteIndex < packedCells.size(); byteIndex++) {
+            uint8_t packedByte = packedCells[byteIndex];
+            for (size_t cell = 0; packedByte != 0; cell++, packedByte >>= 2) {
+                if ((packedByte & 3) != OPEN_GROUND) {
+                    size_t index = (byteIndex << 2) + cell;
+                    visitor(Point((int) (index % columns), (int) (index / columns)), (TerrainType) (packedByte & 3));
+                }
+            }
+        }
+    }
+
+    /**
+     * Converts a map file character to its terrain type
+     * @param mapChar character read from the map file
+     * @return terrain type, open ground for anything that is not water or an obstacle
+     */
+    static TerrainType fromChar(char mapChar) {
+        return mapChar == '~' ? WATER : mapChar == '#' ? OBSTACLE : OPEN_GROUND;
+    }
+
+    /**
+     * Converts a terrain type back to its map file character
+     * @param terrainType terrain type to convert
+     * @return map file character
+     */
+    static char toChar(TerrainType terrainType) {
+        return terrainType == WATER ? '~' : terrainType == OBSTACLE ? '#' : ' ';
+    }
+
+    size_t memoryFootprint() const { return packedCells.size(); }
+
+    void writeTo(BinaryWriter &writer) const { writer.writeArray(packedCells); }
+
+    /**
+     * Reads the packed cells written by writeTo into a raster that was already reset to the saved dimensions
+     * @param reader checkpoint being read
+     * @return false if the data could not be read or does not fit the raster
+     */
+    bool readFrom(BinaryReader &reader) {
+        size_t expectedSize = packedCells.size();
+        return reader.readArray(packedCells) && packedCells.size() == expectedSize;
+    }
+
+private:
+    size_t cellIndex(const Point &location) const {
+        return (size_t) location.second * columns + location.first;
+    }
+
+    int rows = 0;
+    int columns = 0;
+    std::vector<uint8_t> packedCells;
+};
+
+#endif //ECOSIM_TERRAIN_RASTER_HPP
@@ -3,133 +3,1044 @@
 #include "catch.hpp"
 #include <map>
 #include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <cstring>
 
 #include "sim_utilities.hpp"
 #include "map_manager.hpp"
+#include "tick_engine.hpp"
+#include "thread_pool.hpp"
+#include "tick_stats.hpp"
+#include "checkpoint.hpp"
+#include "binary_io.hpp"
+#include "run_length_codec.hpp"
+#include "map_renderer.hpp"
+#include "triple_buffer.hpp"
+#include "trace_recorder.hpp"
+#include "population_recorder.hpp"
+#include "action_log.hpp"
+#include "world.hpp"
+#include "ensemble_runner.hpp"
+#include "ecosim.h"
 #include "species_type.hpp"
-#include "ecosystem_element.hpp"
+#include "entity_store.hpp"
+#include "species_table.hpp"
 #include "plant.hpp"
 #include "herbivore.hpp"
 #include "omnivore.hpp"
 
+/**
+ * Checks that the pending buffers mirror the committed state and that every living animal is found in its own cell
+ * @return true if the world is consistent
+ */
+static bool buffersInSync() {
+    bool buffersMatch = true;
+    for (int row = 0; row < MapManager::mapRows(); row++) {
+        for (int column = 0; column < MapManager::mapColumns(); column++) {
+            Point location(column, row);
+            buffersMatch &= MapManager::floraFauna().flora(location) == MapManager::nextFloraFauna().flora(location);
+            buffersMatch &= MapManager::floraFauna().fauna(location) == MapManager::nextFloraFauna().fauna(location);
+        }
+    }
+    MapManager::entities().forEachAlive([&](EntityId id) {
+        buffersMatch &= MapManager::nextEntities().isAlive(id);
+        buffersMatch &= MapManager::entities().getLocation(id) == MapManager::nextEntities().getLocation(id);
+        buffersMatch &= MapManager::entities().getEnergy(id) == MapManager::nextEntities().getEnergy(id);
+        if (MapManager::speciesOf(id).speciesType != SpeciesType::PLANT) {
+            buffersMatch &= MapManager::floraFauna().fauna(MapManager::entities().getLocation(id)) == id;
+        }
+    });
+
+    // Member lists hold exactly the living elements of their species
+    size_t memberCount = 0;
+    for (size_t speciesIndex = 0; speciesIndex < MapManager::species().size(); speciesIndex++) {
+        auto index = (SpeciesIndex) speciesIndex;
+        for (EntityId id: MapManager::entities().membersOf(index)) {
+            buffersMatch &= MapManager::entities().isAlive(id) && MapManager::entities().getSpecies(id) == index;
+        }
+        buffersMatch &= MapManager::entities().membersOf(index) == MapManager::nextEntities().membersOf(index);
+        memberCount += MapManager::entities().countOf(index);
+    }
+    buffersMatch &= memberCount == MapManager::entities().aliveCount();
+    return buffersMatch;
+}
+
 TEST_CASE("EcoSim Test Suite") {
     SECTION("Map and species file loading") {
-        unordered_map<char, SimUtilities::SpeciesTraits> speciesList;
+        SpeciesTable speciesList;
         // Load species list
         speciesList = SimUtilities::loadSpeciesList("test_input/species.txt");
 
         // Load map into memory
         SimUtilities::loadMap("test_input/map.txt", speciesList);
 
-        REQUIRE(MapManager::mapRows == 10);
-        REQUIRE(MapManager::mapColumns == 45);
-
-        int numPlants = 0;
-        for (auto &element: MapManager::floraFauna) {
-            if (element.second->getSpeciesType() == SpeciesType::PLANT) {
-                numPlants++;
-            }
-        }
-
-        int numHerbivores = 0;
-        for (auto &element: MapManager::floraFauna) {
-            if (element.second->getSpeciesType() == SpeciesType::HERBIVORE) {
-                numHerbivores++;
-            }
-        }
+        REQUIRE(MapManager::mapRows() == 10);
+        REQUIRE(MapManager::mapColumns() == 45);
 
-        int numOmnivores = 0;
-        for (auto &element: MapManager::floraFauna) {
-            if (element.second->getSpeciesType() == SpeciesType::OMNIVORE) {
-                numOmnivores++;
+        size_t numPlants = 0;
+        size_t numHerbivores = 0;
+        size_t numOmnivores = 0;
+        for (size_t speciesIndex = 0; speciesIndex < MapManager::species().size(); speciesIndex++) {
+            auto index = (SpeciesIndex) speciesIndex;
+            switch (MapManager::species()[index].speciesType) {
+                case SpeciesType::PLANT:
+                    numPlants += MapManager::entities().countOf(index);
+                    break;
+                case SpeciesType::HERBIVORE:
+                    numHerbivores += MapManager::entities().countOf(index);
+                    break;
+                case SpeciesType::OMNIVORE:
+                    numOmnivores += MapManager::entities().countOf(index);
+                    break;
+                default:
+                    break;
             }
         }
 
         REQUIRE(numPlants == 35);
         REQUIRE(numHerbivores == 8);
         REQUIRE(numOmnivores == 10);
+
+        auto populations = SimUtilities::speciesPopulations();
+        REQUIRE(accumulate(populations.begin(), populations.end(), (size_t) 0) == 53);
+    }
+
+    SECTION("Species table") {
+        const SpeciesTable &species = MapManager::species();
+        REQUIRE(species.size() == 6);
+        REQUIRE(species.indexOf('?') == -1);
+        REQUIRE(species[species.indexOf('A')].speciesType == SpeciesType::HERBIVORE);
+        REQUIRE(species[species.indexOf('C')].energy == 40);
+        REQUIRE(species.canEat(species.indexOf('D'), species.indexOf('C')));
+        REQUIRE_FALSE(species.canEat(species.indexOf('B'), species.indexOf('a')));
+    }
+
+    SECTION("Packed terrain raster") {
+        REQUIRE(MapManager::terrain().get(Point(0, 0)) == TerrainType::WATER);
+        REQUIRE(MapManager::terrain().get(Point(5, 0)) == TerrainType::OBSTACLE);
+        REQUIRE(MapManager::terrain().isPassable(Point(3, 0)));
+        REQUIRE_FALSE(MapManager::terrain().isPassable(Point(0, 9)));
+
+        // Two bits per cell rounded up to whole bytes
+        REQUIRE(MapManager::terrain().memoryFootprint() == (10 * 45 + 3) / 4);
     }
 
     SECTION("Edible flora fauna around animals") {
-        auto floraFaunaIter = MapManager::floraFauna.find(Point(40, 1));
-        auto foodNearby = MapManager::edibleFloraFaunaNearby(*floraFaunaIter->second);
+        auto foundElement = MapManager::floraFauna().topElement(Point(40, 1));
+        auto foodNearby = MapManager::edibleFloraFaunaNearby(foundElement);
         REQUIRE(foodNearby.empty());
 
-        floraFaunaIter = MapManager::floraFauna.find(Point(44, 5));
-        foodNearby = MapManager::edibleFloraFaunaNearby(*floraFaunaIter->second);
+        foundElement = MapManager::floraFauna().topElement(Point(44, 5));
+        foodNearby = MapManager::edibleFloraFaunaNearby(foundElement);
         REQUIRE(foodNearby.size() == 1);
     }
 
     SECTION("Free locations around animals") {
         // Test location on top of map
-        auto floraFaunaIter = MapManager::floraFauna.find(Point(13, 0));
-        auto availableLocations = MapManager::freeLocations(*floraFaunaIter->second);
+        auto foundElement = MapManager::floraFauna().topElement(Point(13, 0));
+        auto availableLocations = MapManager::freeLocations(foundElement);
         REQUIRE(availableLocations.size() == 3);
 
         // Test location surrounded on all sides
-        floraFaunaIter = MapManager::floraFauna.find(Point(5, 1));
-        availableLocations = MapManager::freeLocations(*floraFaunaIter->second);
+        foundElement = MapManager::floraFauna().topElement(Point(5, 1));
+        availableLocations = MapManager::freeLocations(foundElement);
         REQUIRE(availableLocations.empty());
 
         // Test location on side of map with other element near
-        floraFaunaIter = MapManager::floraFauna.find(Point(44, 5));
-        availableLocations = MapManager::freeLocations(*floraFaunaIter->second);
+        foundElement = MapManager::floraFauna().topElement(Point(44, 5));
+        availableLocations = MapManager::freeLocations(foundElement);
         REQUIRE(availableLocations.size() == 2);
     }
 
     SECTION("Available mates around animals") {
-        auto floraFaunaIter = MapManager::floraFauna.find(Point(10, 9));
-        auto matesNearby = MapManager::nearbyMates(*floraFaunaIter->second);
+        auto foundElement = MapManager::floraFauna().topElement(Point(10, 9));
+        auto matesNearby = MapManager::nearbyMates(foundElement);
         REQUIRE(matesNearby.size() == 1);
 
-        floraFaunaIter = MapManager::floraFauna.find(Point(5, 1));
-        matesNearby = MapManager::nearbyMates(*floraFaunaIter->second);
+        foundElement = MapManager::floraFauna().topElement(Point(5, 1));
+        matesNearby = MapManager::nearbyMates(foundElement);
         REQUIRE(matesNearby.empty());
     }
 
     SECTION("General movement") {
-        auto floraFaunaIter = MapManager::floraFauna.find(Point(21, 8));
-        MapManager::moveElement(*floraFaunaIter->second, Point(21, 7));
+        auto foundElement = MapManager::floraFauna().topElement(Point(21, 8));
+        REQUIRE(MapManager::moveElement(foundElement, Point(21, 7)));
+        MapManager::swapBuffers();
 
-        floraFaunaIter = MapManager::floraFauna.find(Point(21, 7));
+        foundElement = MapManager::floraFauna().topElement(Point(21, 7));
 
-        REQUIRE(floraFaunaIter != MapManager::floraFauna.end());
+        REQUIRE(foundElement != NO_ENTITY);
 
         // Check that the cached location was updated properly
-        REQUIRE(floraFaunaIter->second->getCachedLocation() == Point(21, 7));
+        REQUIRE(MapManager::entities().getLocation(foundElement) == Point(21, 7));
     }
 
     SECTION("Movement over plants") {
-        auto floraFaunaIter = MapManager::floraFauna.find(Point(17, 6));
-        MapManager::moveElement(*floraFaunaIter->second, Point(17, 5));
+        auto foundElement = MapManager::floraFauna().topElement(Point(17, 6));
+        MapManager::moveElement(foundElement, Point(17, 5));
+        MapManager::swapBuffers();
 
-        auto foundElements = MapManager::floraFauna.equal_range(Point(17, 5));
-        int numFoundElements = distance(foundElements.first, foundElements.second);
-
-        REQUIRE(numFoundElements == 2);
+        // The animal stands on the fauna layer above the plant
+        REQUIRE(MapManager::floraFauna().flora(Point(17, 5)) != NO_ENTITY);
+        REQUIRE(MapManager::floraFauna().fauna(Point(17, 5)) != NO_ENTITY);
     }
 
     SECTION("Herbivores eating") {
-        auto floraFaunaIter = MapManager::floraFauna.find(Point(18, 6));
-        MapManager::eatElement(*floraFaunaIter->second, Point(18, 5));
+        auto foundElement = MapManager::floraFauna().topElement(Point(18, 6));
+        MapManager::eatElement(foundElement, Point(18, 5));
+        MapManager::swapBuffers();
+
+        foundElement = MapManager::floraFauna().flora(Point(18, 5));
 
-        floraFaunaIter = MapManager::floraFauna.find(Point(18, 5));
+        REQUIRE(MapManager::entities().isGrown(foundElement) == false);
+    }
+
+    SECTION("Conflicting writes within a phase") {
+        EntityId firstMover = MapManager::floraFauna().fauna(Point(17, 5));
+        EntityId secondMover = MapManager::floraFauna().fauna(Point(18, 5));
+        REQUIRE(MapManager::moveElement(firstMover, Point(17, 6)));
+
+        // Queries keep reading the committed state until the phase is committed
+        REQUIRE(MapManager::floraFauna().fauna(Point(17, 6)) == NO_ENTITY);
 
-        REQUIRE(floraFaunaIter->second->getIsGrown() == false);
+        // The cell was already claimed by the first mover
+        REQUIRE_FALSE(MapManager::moveElement(secondMover, Point(17, 6)));
+        MapManager::swapBuffers();
+
+        REQUIRE(MapManager::floraFauna().fauna(Point(17, 6)) == firstMover);
+        REQUIRE(MapManager::floraFauna().fauna(Point(18, 5)) == secondMover);
+        REQUIRE(MapManager::nextFloraFauna().fauna(Point(17, 6)) == firstMover);
     }
 
     SECTION("Omnivores eating") {
-        auto floraFaunaIter = MapManager::floraFauna.find(Point(10, 8));
-        MapManager::eatElement(*floraFaunaIter->second, Point(10, 9));
+        auto foundElement = MapManager::floraFauna().topElement(Point(10, 8));
+        MapManager::eatElement(foundElement, Point(10, 9));
+        MapManager::swapBuffers();
+
+        // The eaten animal is removed and the eater takes over its cell
+        foundElement = MapManager::floraFauna().fauna(Point(10, 9));
+
+        REQUIRE(MapManager::speciesOf(foundElement).charID == 'D');
+        REQUIRE(MapManager::entities().getEnergy(foundElement) == MapManager::speciesOf(foundElement).energy);
+    }
+
+    SECTION("Double-buffered ticks") {
+        for (int tickNum = 0; tickNum < 25; tickNum++) {
+            TickEngine::runTick();
+        }
+
+        REQUIRE(buffersInSync());
+        REQUIRE(MapManager::entities().aliveCount() == MapManager::nextEntities().aliveCount());
+    }
 
-        auto foundElements = MapManager::floraFauna.equal_range(Point(10, 9));
+    SECTION("Multithreaded tiled ticks") {
+        TickEngine::setThreadCount(3);
+        for (int tickNum = 0; tickNum < 25; tickNum++) {
+            TickEngine::runTick();
+        }
+        TickEngine::setThreadCount(1);
+
+        REQUIRE(buffersInSync());
+    }
+}
+
+TEST_CASE("Work-stealing thread pool") {
+    ThreadPool pool(4);
+    vector<int> runCounts(1000, 0);
+
+    // Uneven task lengths force the workers to steal from each other
+    pool.run(runCounts.size(), [&](size_t taskIndex) {
+        if (taskIndex < 100) {
+            this_thread::sleep_for(chrono::microseconds(200));
+        }
+        runCounts[taskIndex]++;
+    });
+
+    REQUIRE(count(runCounts.begin(), runCounts.end(), 1) == 1000);
+
+    uint64_t tasksRun = 0;
+    for (const WorkerStats &workerStats: pool.getWorkerStats()) {
+        tasksRun += workerStats.tasksRun;
+    }
+    REQUIRE(tasksRun == 1000);
+}
 
-        for (auto elementIter = foundElements.first; elementIter != foundElements.second; ++elementIter) {
-            if (elementIter->second->getCharID() == 'C') {
-                REQUIRE(elementIter->second->getCurrentEnergy() == 0);
-            } else if (elementIter->second->getCharID() == 'D') {
-                REQUIRE(elementIter->second->getCurrentEnergy() == elementIter->second->getMaxEnergy());
+TEST_CASE("Seeded runs are reproducible") {
+    // Known answer for a zero counter and key from the Philox reference implementation
+    auto block = CounterRng::philox({0, 0, 0, 0}, {0, 0});
+    REQUIRE(block == array<uint32_t, 4>{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+
+    auto runSeeded = [](int threadCount) {
+        SimUtilities::loadMap("test_input/map.txt", SimUtilities::loadSpeciesList("test_input/species.txt"));
+        TickEngine::setSeed(1234);
+        TickEngine::setTickCount(0);
+        TickEngine::setThreadCount(threadCount);
+        for (int tickNum = 0; tickNum < 30; tickNum++) {
+            TickEngine::runTick();
+        }
+        TickEngine::setThreadCount(1);
+
+        vector<pair<EntityId, int>> finalState;
+        MapManager::floraFauna().forEachElement([&](EntityId id) {
+            finalState.emplace_back(id, MapManager::entities().getEnergy(id));
+        });
+        return finalState;
+    };
+
+    REQUIRE(runSeeded(1) == runSeeded(3));
+}
+
+TEST_CASE("Tick instrumentation") {
+    SimUtilities::loadMap("test_input/map.txt", SimUtilities::loadSpeciesList("test_input/species.txt"));
+    TickStats::clear();
+
+    // Nothing is kept unless tick statistics were asked for
+    REQUIRE_FALSE(TickStats::isRecording());
+    for (int tickNum = 0; tickNum < 5; tickNum++) {
+        TickEngine::runTick();
+    }
+    REQUIRE(TickStats::getRecords().empty());
+
+    SimUtilities::loadMap("test_input/map.txt", SimUtilities::loadSpeciesList("test_input/species.txt"));
+    TickStats::setRecording(true);
+    TickEngine::setThreadCount(2);
+    for (int tickNum = 0; tickNum < 10; tickNum++) {
+        TickEngine::runTick();
+    }
+    TickEngine::setThreadCount(1);
+    TickStats::setRecording(false);
+
+    const vector<TickRecord> &records = TickStats::getRecords();
+    REQUIRE(records.size() == 10);
+    REQUIRE(records[1].tick == records[0].tick + 1);
+
+    // Every living animal asks for its surroundings three times per tick
+    REQUIRE(records[0].eventCounts[NEIGHBOR_QUERY_EVENT] == 3 * 18);
+    uint64_t moves = 0;
+    for (const TickRecord &record: records) {
+        moves += record.eventCounts[MOVE_EVENT];
+    }
+    REQUIRE(moves > 0);
+}
+
+TEST_CASE("Scheduled plant regrowth") {
+    SimUtilities::loadMap("test_input/map.txt", SimUtilities::loadSpeciesList("test_input/species.txt"));
+    EntityId plant = MapManager::floraFauna().flora(Point(18, 5));
+    int regrowthCoeff = MapManager::speciesOf(plant).regrowthCoeff;
+    long eatenTick = TickEngine::getTickCount();
+    Plant::makeEaten(plant);
+    MapManager::swapBuffers();
+    REQUIRE(MapManager::events().scheduledCount() == 1);
+
+    // Only the plant phases run so no animal can eat the plant once it regrew
+    for (int ticksSinceEaten = 1; ticksSinceEaten <= regrowthCoeff; ticksSinceEaten++) {
+        REQUIRE_FALSE(MapManager::entities().isGrown(plant));
+        TickEngine::setTickCount(eatenTick + ticksSinceEaten);
+        TickEngine::runPlantPhase();
+    }
+    REQUIRE(MapManager::entities().isGrown(plant));
+    REQUIRE(MapManager::events().scheduledCount() == 0);
+}
+
+TEST_CASE("Predation matrix") {
+    // Every species eats the species defined right before it, the first one eats the last one
+    SpeciesTable species;
+    const int speciesCount = 200;
+    for (int index = 0; index < speciesCount; index++) {
+        auto charID = (char) (index + 1);
+        char preyID = (char) (index == 0 ? speciesCount : index);
+        species.add({charID, SpeciesType::OMNIVORE, -1, 10, 5, {preyID}});
+    }
+
+    REQUIRE(species.size() == speciesCount);
+    REQUIRE(species.canEat(0, speciesCount - 1));
+    REQUIRE(species.canEat(150, 149));
+    REQUIRE_FALSE(species.canEat(149, 150));
+    REQUIRE_FALSE(species.canEat(100, 100));
+}
+
+TEST_CASE("Per-species entity pools") {
+    SimUtilities::loadMap("test_input/map.txt", SimUtilities::loadSpeciesList("test_input/species.txt"));
+    auto herbivoreSpecies = (SpeciesIndex) MapManager::species().indexOf('A');
+    EntityStore::PoolStats loadedPool = MapManager::entities().poolStats(herbivoreSpecies);
+    REQUIRE(loadedPool.capacity == EntityStore::SLAB_SIZE);
+    REQUIRE(loadedPool.occupied == loadedPool.highWater);
+
+    // A death followed by a birth reuses the dead animal's slot
+    EntityId victim = MapManager::entities().membersOf(herbivoreSpecies)[0];
+    Point victimLocation = MapManager::entities().getLocation(victim);
+    MapManager::killElement(victim);
+    MapManager::swapBuffers();
+    REQUIRE(MapManager::entities().poolStats(herbivoreSpecies).occupied == loadedPool.occupied - 1);
+
+    REQUIRE(MapManager::queueBirth(herbivoreSpecies, victimLocation));
+    MapManager::swapBuffers();
+    REQUIRE(MapManager::floraFauna().fauna(victimLocation) == victim);
+
+    EntityStore::PoolStats finalPool = MapManager::entities().poolStats(herbivoreSpecies);
+    REQUIRE(finalPool.capacity == loadedPool.capacity);
+    REQUIRE(finalPool.highWater == loadedPool.highWater);
+    REQUIRE(buffersInSync());
+
+    // Copying changes patches the written member list positions and cuts lists that shrank
+    EntityStore store, copy;
+    vector<EntityId> ids;
+    for (int column = 0; column < 5; column++) {
+        ids.push_back(store.create(0, Point(column, 0), 5));
+    }
+    EntityId otherSpecies = store.create(1, Point(0, 1), 5);
+    copy.copyChangesFrom(store);
+    store.clearChanges();
+    store.destroy(ids[1]);
+    store.destroy(ids[4]);
+    store.destroy(otherSpecies);
+    store.releaseDestroyed();
+    store.create(0, Point(9, 9), 5);
+    copy.copyChangesFrom(store);
+    REQUIRE(copy.membersOf(0) == store.membersOf(0));
+    REQUIRE(copy.membersOf(1).empty());
+    REQUIRE(copy.aliveCount() == 4);
+}
+
+TEST_CASE("Binary checkpoints") {
+    SimUtilities::loadMap("test_input/map.txt", SimUtilities::loadSpeciesList("test_input/species.txt"));
+    TickEngine::setSeed(99);
+    TickEngine::setTickCount(0);
+    for (int tickNum = 0; tickNum < 10; tickNum++) {
+        TickEngine::runTick();
+    }
+    REQUIRE(Checkpoint::save("test_checkpoint.bin"));
+
+    auto runAndCapture = []() {
+        for (int tickNum = 0; tickNum < 10; tickNum++) {
+            TickEngine::runTick();
+        }
+        vector<tuple<EntityId, Point, int, bool>> finalState;
+        MapManager::floraFauna().forEachElement([&](EntityId id) {
+            finalState.emplace_back(id, MapManager::entities().getLocation(id), MapManager::entities().getEnergy(id),
+                                    MapManager::entities().isGrown(id));
+        });
+        return finalState;
+    };
+    auto uninterruptedState = runAndCapture();
+
+    // A restored run continues exactly like the original one
+    TickEngine::setSeed(1);
+    REQUIRE(Checkpoint::restore("test_checkpoint.bin"));
+    REQUIRE(TickEngine::getTickCount() == 10);
+    REQUIRE(TickEngine::getSeed() == 99);
+    REQUIRE(buffersInSync());
+    REQUIRE(runAndCapture() == uninterruptedState);
+
+    // Truncated checkpoints are rejected
+    ifstream checkpointFile("test_checkpoint.bin", ios::binary);
+    string checkpointBytes((istreambuf_iterator<char>(checkpointFile)), istreambuf_iterator<char>());
+    ofstream("test_checkpoint.bin", ios::binary) << checkpointBytes.substr(0, checkpointBytes.size() / 2);
+    REQUIRE_FALSE(Checkpoint::restore("test_checkpoint.bin"));
+    REQUIRE(MapManager::entities().aliveCount() == 0);
+
+    // Dimensions the file is too short for are rejected before anything is allocated for them
+    string hugeBytes = checkpointBytes;
+    int32_t hugeSide = INT32_MAX;
+    memcpy(&hugeBytes[12], &hugeSide, sizeof(hugeSide));
+    memcpy(&hugeBytes[16], &hugeSide, sizeof(hugeSide));
+    ofstream("test_checkpoint.bin", ios::binary) << hugeBytes;
+    REQUIRE_FALSE(Checkpoint::restore("test_checkpoint.bin"));
+
+    // Saving the same world twice gives the same bytes
+    ofstream("test_checkpoint.bin", ios::binary) << checkpointBytes;
+    REQUIRE(Checkpoint::restore("test_checkpoint.bin"));
+    REQUIRE(Checkpoint::save("test_checkpoint.bin"));
+    ifstream resavedFile("test_checkpoint.bin", ios::binary);
+    REQUIRE(string((istreambuf_iterator<char>(resavedFile)), istreambuf_iterator<char>()) == checkpointBytes);
+    resavedFile.close();
+
+    // So does the same run on more threads, whose workers stage regrowth events in a different order
+    SimUtilities::loadMap("test_input/map.txt", SimUtilities::loadSpeciesList("test_input/species.txt"));
+    TickEngine::setSeed(99);
+    TickEngine::setTickCount(0);
+    TickEngine::setThreadCount(3);
+    for (int tickNum = 0; tickNum < 10; tickNum++) {
+        TickEngine::runTick();
+    }
+    TickEngine::setThreadCount(1);
+    REQUIRE(Checkpoint::save("test_checkpoint.bin"));
+    ifstream threadedFile("test_checkpoint.bin", ios::binary);
+    REQUIRE(string((istreambuf_iterator<char>(threadedFile)), istreambuf_iterator<char>()) == checkpointBytes);
+    threadedFile.close();
+
+    // Two animals on one cell are rejected
+    EntityId animal = MapManager::floraFauna().fauna(MapManager::entities().getLocation(
+            MapManager::entities().membersOf((SpeciesIndex) MapManager::species().indexOf('A'))[0]));
+    MapManager::entities().create(MapManager::entities().getSpecies(animal), MapManager::entities().getLocation(animal),
+                                  10);
+    REQUIRE(Checkpoint::save("test_checkpoint.bin"));
+    REQUIRE_FALSE(Checkpoint::restore("test_checkpoint.bin"));
+    remove("test_checkpoint.bin");
+}
+
+TEST_CASE("Checkpointed entity stores") {
+    // One element fills the first slot of a slab, the rest of the slab is chained on the species' free list
+    EntityStore store;
+    store.create(0, Point(0, 0), 5);
+    const size_t slots = EntityStore::SLAB_SIZE;
+    size_t nextFreeOffset = (8 + slots * sizeof(Point)) + (8 + slots) + (8 + slots * sizeof(int)) + (8 + slots) + 8;
+    size_t freeHeadOffset = nextFreeOffset + slots * sizeof(EntityId) + (8 + slots * sizeof(uint32_t)) + 8;
+    {
+        BinaryWriter writer("test_store.bin");
+        store.writeTo(writer);
+        REQUIRE(writer.good());
+    }
+
+    ifstream storeFile("test_store.bin", ios::binary);
+    string storeBytes((istreambuf_iterator<char>(storeFile)), istreambuf_iterator<char>());
+    storeFile.close();
+    auto readsBack = [](const string &bytes) {
+        ofstream("test_store.bin", ios::binary) << bytes;
+        BinaryReader reader("test_store.bin");
+        EntityStore restored;
+        return restored.readFrom(reader) && restored.aliveCount() == 1;
+    };
+    auto patchId = [](string bytes, size_t offset, EntityId id) {
+        memcpy(&bytes[offset], &id, sizeof(id));
+        return bytes;
+    };
+    REQUIRE(readsBack(storeBytes));
+
+    // Free lists may neither loop nor hold a living slot
+    REQUIRE_FALSE(readsBack(patchId(storeBytes, nextFreeOffset + (slots - 1) * sizeof(EntityId), 1)));
+    REQUIRE_FALSE(readsBack(patchId(storeBytes, freeHeadOffset, 0)));
+    remove("test_store.bin");
+}
+
+TEST_CASE("Parallel map loading") {
+    // Tile the test map into a map spanning several loader tasks, with CRLF line endings
+    ifstream testMap("test_input/map.txt");
+    vector<string> mapLines;
+    for (string mapLine; getline(testMap, mapLine);) {
+        mapLines.push_back(mapLine);
+    }
+    ofstream largeMap("test_large_map.txt", ios::binary);
+    for (int row = 0; row < 600; row++) {
+        largeMap << mapLines[row % mapLines.size()] << "\r\n";
+    }
+    largeMap.close();
+
+    auto loadAndCapture = [](int threadCount) {
+        SimUtilities::loadMap("test_large_map.txt", SimUtilities::loadSpeciesList("test_input/species.txt"),
+                              threadCount);
+        vector<tuple<EntityId, Point, SpeciesIndex>> loadedState;
+        MapManager::floraFauna().forEachElement([&](EntityId id) {
+            loadedState.emplace_back(id, MapManager::entities().getLocation(id), MapManager::entities().getSpecies(id));
+        });
+        return loadedState;
+    };
+
+    auto singleThreadState = loadAndCapture(1);
+    REQUIRE(MapManager::mapRows() == 600);
+    REQUIRE(MapManager::mapColumns() == 45);
+    REQUIRE(MapManager::entities().aliveCount() == 60 * 53);
+    REQUIRE(MapManager::terrain().get(Point(0, 0)) == MapManager::terrain().get(Point(0, 10)));
+    REQUIRE(loadAndCapture(3) == singleThreadState);
+    REQUIRE(buffersInSync());
+    remove("test_large_map.txt");
+}
+
+TEST_CASE("Streaming map writer") {
+    // Runs of the marker byte and runs longer than one varint byte survive a round trip
+    string rawBytes = string(300, ' ') + "PPP" + string(5, '\0') + "~#" + string(1, '\0');
+    string encodedBytes = RunLengthCodec::MAGIC;
+    RunLengthCodec::encode(rawBytes.data(), rawBytes.size(), encodedBytes);
+    vector<char> decodedBytes;
+    REQUIRE(RunLengthCodec::decode(encodedBytes.data(), encodedBytes.size(), decodedBytes));
+    REQUIRE(string(decodedBytes.begin(), decodedBytes.end()) == rawBytes);
+    REQUIRE_FALSE(RunLengthCodec::decode(encodedBytes.data(), encodedBytes.size() - 1, decodedBytes));
+
+    auto captureWorld = []() {
+        vector<tuple<Point, SpeciesIndex>> elements;
+        MapManager::floraFauna().forEachElement([&](EntityId id) {
+            elements.emplace_back(MapManager::entities().getLocation(id), MapManager::entities().getSpecies(id));
+        });
+        return elements;
+    };
+
+    SpeciesTable speciesList = SimUtilities::loadSpeciesList("test_input/species.txt");
+    SimUtilities::loadMap("test_input/map.txt", speciesList);
+    auto loadedWorld = captureWorld();
+    REQUIRE(MapManager::saveMapToFile("test_saved_map.txt"));
+    REQUIRE(MapManager::saveMapToFile("test_saved_map.rle", true));
+
+    // Both forms load back into the same world
+    SimUtilities::loadMap("test_saved_map.txt", speciesList);
+    REQUIRE(captureWorld() == loadedWorld);
+    SimUtilities::loadMap("test_saved_map.rle", speciesList);
+    REQUIRE(MapManager::mapRows() == 10);
+    REQUIRE(MapManager::mapColumns() == 45);
+    REQUIRE(captureWorld() == loadedWorld);
+    remove("test_saved_map.txt");
+    remove("test_saved_map.rle");
+}
+
+TEST_CASE("Incremental map renderer") {
+    SimUtilities::loadMap("test_input/map.txt", SimUtilities::loadSpeciesList("test_input/species.txt"));
+    TickEngine::setSeed(5);
+    Viewport viewport(100, 100);
+    FrameCapture frameCapture(viewport);
+    MapRenderer mapRenderer;
+    MapFrame frame;
+
+    // Apply every frame's changes to a mirror of the screen, which has to match a full repaint of the world
+    vector<CellGlyph> screen((size_t) MapManager::mapRows() * MapManager::mapColumns());
+    auto applyFrame = [&]() {
+        const auto &changesByColor = mapRenderer.changesByColor();
+        size_t changeCount = 0;
+        for (size_t colorPair = 0; colorPair < changesByColor.size(); colorPair++) {
+            for (const auto &change: changesByColor[colorPair]) {
+                screen[change.first] = {change.second, (short) colorPair};
+                changeCount++;
             }
         }
+        return changeCount;
+    };
+    auto screenMatchesWorld = [&]() {
+        bool screenMatches = true;
+        for (size_t index = 0; index < screen.size(); index++) {
+            screenMatches &= screen[index] == FrameCapture::glyphAt(index);
+        }
+        return screenMatches;
+    };
+
+    frameCapture.capture(frame);
+    REQUIRE(mapRenderer.collectChanges(frame));
+    // The first frame paints every element and every water and obstacle cell
+    REQUIRE(applyFrame() == 53 + 111);
+    bool screenMatches = true;
+    for (int tickNum = 0; tickNum < 20; tickNum++) {
+        // Frames that are captured but never drawn are simply skipped
+        TickEngine::runTick();
+        frameCapture.capture(frame);
+        TickEngine::runTick();
+        frameCapture.capture(frame);
+        REQUIRE(frame.tick == TickEngine::getTickCount());
+        REQUIRE_FALSE(mapRenderer.collectChanges(frame));
+        REQUIRE(applyFrame() < screen.size() / 2);
+        screenMatches &= screenMatchesWorld();
+    }
+    REQUIRE(screenMatches);
+}
+
+TEST_CASE("Viewport and overview") {
+    SimUtilities::loadMap("test_input/map.txt", SimUtilities::loadSpeciesList("test_input/species.txt"));
+    TickEngine::setSeed(8);
+    Viewport viewport(4, 10);
+    MapFrame frame;
+    {
+        FrameCapture frameCapture(viewport);
+
+        // Only the visible window is captured and scrolling stops at the map edges
+        viewport.scrollBy(3, 100);
+        frameCapture.capture(frame);
+        REQUIRE(frame.rows == 4);
+        REQUIRE(frame.columns == 10);
+        REQUIRE(viewport.getLeft() == 35);
+        REQUIRE(frame.glyphs[2 * 10 + 4] == FrameCapture::glyphAt(5 * 45 + 39));
+
+        // Glyphs patched from the changed cells match looking every visible cell up again, also after scrolling
+        auto frameMatchesWorld = [&]() {
+            bool frameMatches = true;
+            for (int row = 0; row < frame.rows; row++) {
+                for (int column = 0; column < frame.columns; column++) {
+                    size_t cellIndex = (size_t) (viewport.getTop() + row) * 45 + viewport.getLeft() + column;
+                    frameMatches &= frame.glyphs[(size_t) row * frame.columns + column] ==
+                                    FrameCapture::glyphAt(cellIndex);
+                }
+            }
+            return frameMatches;
+        };
+        bool framesMatch = true;
+        for (int tickNum = 0; tickNum < 10; tickNum++) {
+            TickEngine::runTick();
+            frameCapture.capture(frame);
+            framesMatch &= frameMatchesWorld();
+            viewport.scrollBy(tickNum % 3 == 0 ? -2 : 0, tickNum % 4 == 0 ? -7 : 0);
+        }
+        REQUIRE(framesMatch);
+
+        // Overview blocks fitting the whole map in the window, kept up to date while the world changes
+        viewport.toggleOverview();
+        REQUIRE(viewport.getBlockSize() == 5);
+        for (int tickNum = 0; tickNum < 15; tickNum++) {
+            TickEngine::runTick();
+            frameCapture.capture(frame);
+        }
+        REQUIRE(frame.rows == 2);
+        REQUIRE(frame.columns == 9);
+    }
+
+    // Block counts maintained from the changed cells match counting the final world from scratch
+    FrameCapture freshCapture(viewport);
+    MapFrame recountedFrame;
+    freshCapture.capture(recountedFrame);
+    REQUIRE(frame.glyphs == recountedFrame.glyphs);
+}
+
+TEST_CASE("Triple-buffered frames") {
+    TripleBuffer<long> frames;
+    REQUIRE_FALSE(frames.consume());
+    frames.backBuffer() = 1;
+    frames.publish();
+    frames.backBuffer() = 2;
+    frames.publish();
+    REQUIRE(frames.consume());
+    REQUIRE(frames.frontBuffer() == 2);
+    REQUIRE_FALSE(frames.consume());
+
+    // A consumer racing the producer only ever sees newer complete buffers
+    const long LAST_FRAME = 200000;
+    TripleBuffer<array<long, 8>> paddedFrames;
+    thread producer([&]() {
+        for (long frameNumber = 1; frameNumber <= LAST_FRAME; frameNumber++) {
+            paddedFrames.backBuffer().fill(frameNumber);
+            paddedFrames.publish();
+        }
+    });
+    long lastSeen = 0;
+    bool framesConsistent = true;
+    while (lastSeen < LAST_FRAME) {
+        if (paddedFrames.consume()) {
+            const array<long, 8> &frame = paddedFrames.frontBuffer();
+            framesConsistent &= frame[0] > lastSeen && frame[7] == frame[0];
+            lastSeen = frame[0];
+        }
+    }
+    producer.join();
+    REQUIRE(framesConsistent);
+}
+
+TEST_CASE("Chrome trace export") {
+    SimUtilities::loadMap("test_input/map.txt", SimUtilities::loadSpeciesList("test_input/species.txt"));
+    TraceRecorder::setThreadName("main");
+    TraceRecorder::start();
+    TickEngine::setThreadCount(2);
+    for (int tickNum = 0; tickNum < 3; tickNum++) {
+        TickEngine::runTick();
+    }
+    TickEngine::setThreadCount(1);
+
+    ostringstream traceStream;
+    TraceRecorder::writeJson(traceStream);
+    string trace = traceStream.str();
+    REQUIRE(trace.find("\"name\":\"tick\",\"ph\":\"X\"") != string::npos);
+    REQUIRE(trace.find("\"name\":\"herbivore phase\"") != string::npos);
+    REQUIRE(trace.find("\"args\":{\"name\":\"pool worker 1\"}") != string::npos);
+
+    // Full ring buffers keep the newest spans only
+    TraceRecorder::clear();
+    TraceRecorder::start();
+    for (size_t spanNum = 0; spanNum < TraceRecorder::SPANS_PER_THREAD + 10; spanNum++) {
+        TraceSpan span(spanNum < 10 ? "oldest" : "newer");
+    }
+    traceStream.str("");
+    TraceRecorder::writeJson(traceStream);
+    trace = traceStream.str();
+    REQUIRE(trace.find("oldest") == string::npos);
+    REQUIRE(trace.find("newer") != string::npos);
+    TraceRecorder::clear();
+}
+
+TEST_CASE("Population time series") {
+    SimUtilities::loadMap("test_input/map.txt", SimUtilities::loadSpeciesList("test_input/species.txt"));
+    vector<size_t> startPopulations = SimUtilities::speciesPopulations();
+    REQUIRE(PopulationRecorder::start("test_population.bin"));
+    TickEngine::setThreadCount(2);
+    for (int tickNum = 0; tickNum < 10; tickNum++) {
+        TickEngine::runTick();
+    }
+    TickEngine::setThreadCount(1);
+    REQUIRE(PopulationRecorder::stop());
+
+    ostringstream csvStream;
+    REQUIRE(PopulationRecorder::exportCsv("test_population.bin", csvStream));
+    istringstream csvLines(csvStream.str());
+    string line;
+    getline(csvLines, line);
+    REQUIRE(line == "tick,species,population,total_energy,mean_energy,births,deaths,plants_eaten,plants_regrowing");
+
+    size_t speciesCount = MapManager::species().size();
+    vector<long> populations(startPopulations.begin(), startPopulations.end());
+    vector<long> finalRegrowing(speciesCount, 0);
+    vector<int64_t> finalEnergies(speciesCount, 0);
+    size_t rowCount = 0;
+    for (; getline(csvLines, line); rowCount++) {
+        vector<string> fields;
+        stringstream lineStream(line);
+        for (string field; getline(lineStream, field, ',');) {
+            fields.push_back(field);
+        }
+        REQUIRE(fields.size() == 9);
+        size_t index = rowCount % speciesCount;
+        REQUIRE(fields[1][0] == MapManager::species()[(SpeciesIndex) index].charID);
+
+        // Every population change is explained by the births and deaths of the tick
+        long population = stol(fields[2]);
+        REQUIRE(population == populations[index] + stol(fields[5]) - stol(fields[6]));
+        populations[index] = population;
+        finalEnergies[index] = stoll(fields[3]);
+        finalRegrowing[index] = stol(fields[8]);
+    }
+    REQUIRE(rowCount == 10 * speciesCount);
+
+    for (size_t index = 0; index < speciesCount; index++) {
+        auto speciesIndex = (SpeciesIndex) index;
+        REQUIRE((size_t) populations[index] == MapManager::entities().countOf(speciesIndex));
+        int64_t totalEnergy = 0;
+        long regrowing = 0;
+        for (EntityId id: MapManager::entities().membersOf(speciesIndex)) {
+            totalEnergy += MapManager::entities().getEnergy(id);
+            regrowing += !MapManager::entities().isGrown(id);
+        }
+        REQUIRE(finalEnergies[index] == totalEnergy);
+        if (MapManager::species()[speciesIndex].speciesType == SpeciesType::PLANT) {
+            REQUIRE(finalRegrowing[index] == regrowing);
+        }
+    }
+
+    REQUIRE_FALSE(PopulationRecorder::exportCsv("test_input/map.txt", csvStream));
+    remove("test_population.bin");
+}
+
+TEST_CASE("Action log replay") {
+    auto captureState = []() {
+        vector<tuple<EntityId, Point, int, bool>> state;
+        MapManager::floraFauna().forEachElement([&](EntityId id) {
+            state.emplace_back(id, MapManager::entities().getLocation(id), MapManager::entities().getEnergy(id),
+                               MapManager::entities().isGrown(id));
+        });
+        return make_pair(state, MapManager::events().scheduledCount());
+    };
+    auto loadInitialWorld = []() {
+        SimUtilities::loadMap("test_input/map.txt", SimUtilities::loadSpeciesList("test_input/species.txt"));
+        TickEngine::setTickCount(0);
+    };
+
+    loadInitialWorld();
+    TickEngine::setSeed(7);
+    TickEngine::setThreadCount(2);
+    REQUIRE(ActionLog::startRecording("test_actions.bin"));
+    for (int tickNum = 0; tickNum < 10; tickNum++) {
+        TickEngine::runTick();
+    }
+    auto stateAtTick10 = captureState();
+    for (int tickNum = 0; tickNum < 10; tickNum++) {
+        TickEngine::runTick();
+    }
+    auto stateAtTick20 = captureState();
+    REQUIRE(ActionLog::stopRecording());
+    TickEngine::setThreadCount(1);
+
+    // Replay reaches the recorded state of any tick, adopting the recorded seed
+    loadInitialWorld();
+    TickEngine::setSeed(1);
+    REQUIRE(ActionLog::openReplay("test_actions.bin"));
+    REQUIRE(TickEngine::getSeed() == 7);
+    REQUIRE(ActionLog::replayTo(10));
+    REQUIRE(TickEngine::getTickCount() == 10);
+    REQUIRE(captureState() == stateAtTick10);
+    REQUIRE(buffersInSync());
+    REQUIRE_FALSE(ActionLog::replayFinished());
+    REQUIRE(ActionLog::replayTo(1000));
+    REQUIRE(TickEngine::getTickCount() == 20);
+    REQUIRE(ActionLog::replayFinished());
+    REQUIRE(captureState() == stateAtTick20);
+
+    // Without keyframes the log cannot seek backwards and leaves the world where it is
+    REQUIRE_FALSE(ActionLog::replayTo(10));
+    REQUIRE(captureState() == stateAtTick20);
+
+    // A replayed run continues exactly like the recorded one
+    loadInitialWorld();
+    REQUIRE(ActionLog::openReplay("test_actions.bin"));
+    REQUIRE(ActionLog::replayTo(10));
+    ActionLog::closeReplay();
+    for (int tickNum = 0; tickNum < 10; tickNum++) {
+        TickEngine::runTick();
+    }
+    REQUIRE(captureState() == stateAtTick20);
+
+    // Keyframes let a replay seek to any tick, backwards as well, and a missing keyframe fails the seek
+    loadInitialWorld();
+    TickEngine::setSeed(7);
+    REQUIRE(ActionLog::startRecording("test_keyframes.bin", 5));
+    for (int tickNum = 0; tickNum < 20; tickNum++) {
+        TickEngine::runTick();
+    }
+    REQUIRE(ActionLog::stopRecording());
+    loadInitialWorld();
+    REQUIRE(ActionLog::openReplay("test_keyframes.bin"));
+    REQUIRE(ActionLog::replayTo(12));
+    REQUIRE(TickEngine::getTickCount() == 12);
+    REQUIRE(ActionLog::replayTo(20));
+    REQUIRE(captureState() == stateAtTick20);
+    REQUIRE(ActionLog::replayTo(10));
+    REQUIRE(TickEngine::getTickCount() == 10);
+    REQUIRE(captureState() == stateAtTick10);
+    REQUIRE(buffersInSync());
+    REQUIRE(ActionLog::replayTo(1000));
+    REQUIRE(ActionLog::replayFinished());
+    REQUIRE(captureState() == stateAtTick20);
+    remove(ActionLog::keyframePath("test_keyframes.bin", 15).c_str());
+    REQUIRE_FALSE(ActionLog::replayTo(17));
+    ActionLog::closeReplay();
+    for (long tick: {5, 10, 20}) {
+        remove(ActionLog::keyframePath("test_keyframes.bin", tick).c_str());
     }
+    remove("test_keyframes.bin");
+    remove("test_keyframes.bin.index");
+
+    // Logs are only replayed onto the world they were recorded on, and a log cut off within a tick is corrupt
+    REQUIRE_FALSE(ActionLog::openReplay("test_actions.bin"));
+    ifstream logFile("test_actions.bin", ios::binary);
+    string logBytes((istreambuf_iterator<char>(logFile)), istreambuf_iterator<char>());
+    logFile.close();
+    ofstream("test_actions.bin", ios::binary) << logBytes.substr(0, logBytes.size() - 1);
+    loadInitialWorld();
+    REQUIRE(ActionLog::openReplay("test_actions.bin"));
+    REQUIRE_FALSE(ActionLog::replayTo(1000));
+    ActionLog::closeReplay();
+    remove("test_actions.bin");
+    remove("test_actions.bin.index");
+}
+
+TEST_CASE("Worlds and ensembles") {
+    SimUtilities::loadMap("test_input/map.txt", SimUtilities::loadSpeciesList("test_input/species.txt"));
+    TickEngine::setTickCount(0);
+    World initialWorld = World::current();
+
+    // A copy of a world runs on its own, even on several threads, and leaves the original untouched
+    {
+        World copiedWorld = initialWorld;
+        WorldScope worldScope(copiedWorld);
+        TickEngine::setSeed(5);
+        TickEngine::setThreadCount(2);
+        for (int tickNum = 0; tickNum < 20; tickNum++) {
+            TickEngine::runTick();
+        }
+        TickEngine::setThreadCount(1);
+        REQUIRE(TickEngine::getTickCount() == 20);
+        REQUIRE(buffersInSync());
+    }
+    REQUIRE(TickEngine::getTickCount() == 0);
+    REQUIRE(MapManager::entities().aliveCount() == initialWorld.entities.aliveCount());
+
+    TickEngine::setSeed(5);
+    for (int tickNum = 0; tickNum < 20; tickNum++) {
+        TickEngine::runTick();
+    }
+    vector<size_t> seededPopulations = SimUtilities::speciesPopulations();
+
+    // Replicas with the same seed end up like a run on the default world
+    ofstream("test_species_override.txt") << "plant a 3 50\nherbivore A [a, b] 10\nherbivore Z [a] 10\n";
+    SpeciesTable overrides = SimUtilities::loadSpeciesList("test_species_override.txt");
+    REQUIRE(EnsembleRunner::canOverride(initialWorld.species, overrides));
+    vector<ReplicaSettings> replicas = {{5, 0}, {6, 0}, {5, 0}, {5, 1}};
+    vector<ReplicaResult> results = EnsembleRunner::run(initialWorld, {SpeciesTable(), overrides}, replicas, 20, 3);
+    REQUIRE(results.size() == 4);
+    REQUIRE(results[0].populations == seededPopulations);
+    REQUIRE(results[2].populations == seededPopulations);
+    REQUIRE(results[3].settings.variant == 1);
+
+    // Overridden plants carry their new energy, species that are not on the map are ignored
+    auto plantIndex = (size_t) initialWorld.species.indexOf('a');
+    REQUIRE(results[3].populations.size() == initialWorld.species.size());
+    REQUIRE(results[3].totalEnergies[plantIndex] == 50 * (int64_t) results[3].populations[plantIndex]);
+
+    ostringstream summaryStream;
+    EnsembleRunner::printSummary(summaryStream, results, initialWorld.species, {"base", "override"});
+    REQUIRE(summaryStream.str().find("base: 3 replicas") != string::npos);
+    REQUIRE(summaryStream.str().find("override: 1 replicas") != string::npos);
+
+    // Replicas would write into a running recording, so ensembles are refused while one runs
+    REQUIRE(ActionLog::startRecording("test_ensemble_actions.bin", 0));
+    REQUIRE(EnsembleRunner::run(initialWorld, {SpeciesTable()}, replicas, 20, 3).empty());
+    REQUIRE(ActionLog::stopRecording());
+    remove("test_ensemble_actions.bin");
+    remove("test_ensemble_actions.bin.index");
+
+    // A species may not change its type
+    ofstream("test_species_override.txt") << "herbivore a [b] 10\n";
+    REQUIRE_FALSE(EnsembleRunner::canOverride(initialWorld.species,
+                                              SimUtilities::loadSpeciesList("test_species_override.txt")));
+    remove("test_species_override.txt");
+}
+
+TEST_CASE("C interface") {
+    auto readFile = [](const string &filePath) {
+        ifstream file(filePath, ios::binary);
+        return string((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    };
+    string mapText = readFile("test_input/map.txt");
+    string speciesText = readFile("test_input/species.txt");
+
+    // Per-worker buffers of the recorders are sized for the new world only, never for a world that may be running
+    EcoSimWorld *world = nullptr;
+    TickEngine::setThreadCount(1);
+    REQUIRE(ecosimCreateWorld(mapText.data(), mapText.size(), speciesText.data(), speciesText.size(), 5, 2, &world) ==
+            ECOSIM_OK);
+    REQUIRE(World::current().populationCounts.workerCounts.size() == 1);
+    REQUIRE(World::current().actionLog.workerEntries.size() == 1);
+    REQUIRE(ecosimStep(world, 20) == ECOSIM_OK);
+    REQUIRE(ecosimTickCount(world) == 20);
+
+    // A world of the library runs exactly like the default world loaded from the same files
+    SimUtilities::loadMap("test_input/map.txt", SimUtilities::loadSpeciesList("test_input/species.txt"));
+    TickEngine::setTickCount(0);
+    TickEngine::setSeed(5);
+    for (int tickNum = 0; tickNum < 20; tickNum++) {
+        TickEngine::runTick();
+    }
+    vector<size_t> expectedPopulations = SimUtilities::speciesPopulations();
+    vector<uint64_t> populations(ecosimSpeciesCount(world));
+    REQUIRE(ecosimPopulations(world, populations.data(), populations.size()) == expectedPopulations.size());
+    REQUIRE(equal(populations.begin(), populations.end(), expectedPopulations.begin()));
+    REQUIRE(ecosimSpeciesChar(world, 0) == MapManager::species()[0].charID);
+
+    int32_t rows, columns;
+    ecosimMapSize(world, &rows, &columns);
+    string cells((size_t) rows * columns, '\0');
+    REQUIRE(ecosimReadCells(world, 0, 0, columns, rows, &cells[0]) == ECOSIM_OK);
+    REQUIRE(MapManager::saveMapToFile("test_capi_map.txt"));
+    string savedMap = readFile("test_capi_map.txt");
+    savedMap.erase(remove(savedMap.begin(), savedMap.end(), '\n'), savedMap.end());
+    REQUIRE(cells == savedMap);
+    char corner;
+    REQUIRE(ecosimReadCells(world, columns - 1, rows - 1, 1, 1, &corner) == ECOSIM_OK);
+    REQUIRE(corner == cells.back());
+    REQUIRE(ecosimReadCells(world, columns - 1, 0, 2, 1, &corner) == ECOSIM_INVALID_ARGUMENT);
+
+    // Restoring a saved world continues it exactly like the original
+    REQUIRE(ecosimSave(world, "test_capi_checkpoint.bin") == ECOSIM_OK);
+    REQUIRE(ecosimStep(world, 10) == ECOSIM_OK);
+    vector<uint64_t> laterPopulations(populations.size());
+    ecosimPopulations(world, laterPopulations.data(), laterPopulations.size());
+    REQUIRE(ecosimRestore(world, "test_capi_checkpoint.bin") == ECOSIM_OK);
+    REQUIRE(ecosimTickCount(world) == 20);
+    REQUIRE(ecosimStep(world, 10) == ECOSIM_OK);
+    ecosimPopulations(world, populations.data(), populations.size());
+    REQUIRE(populations == laterPopulations);
+    REQUIRE(ecosimRestore(world, "missing_checkpoint.bin") == ECOSIM_INVALID_INPUT);
+    ecosimDestroyWorld(world);
+
+    // Rejected input is reported instead of exiting
+    string badMap = "a?";
+    REQUIRE(ecosimCreateWorld(badMap.data(), badMap.size(), speciesText.data(), speciesText.size(), 5, 1, &world) ==
+            ECOSIM_INVALID_INPUT);
+    REQUIRE(world == nullptr);
+    REQUIRE(string(ecosimLastError()).find("Unknown species character '?'") != string::npos);
+    remove("test_capi_map.txt");
+    remove("test_capi_checkpoint.bin");
 }
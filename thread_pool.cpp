@@ -0,0 +1,187 @@
+#include "thread_pool.hpp"
+
+#include <chrono>
+#include <iomanip>
+
+#include "trace_recorder.hpp"
+
+thread_local int ThreadPool::currentWorkerIndex = 0;
+
+static double secondsSince(const std::chrono::steady_clock::time_point &startTime) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+ThreadPool::ThreadPool(int workerCount) : workerCount(workerCount < 1 ? 1 : workerCount) {
+    for (int index = 0; index < this->workerCount; index++) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (int index = 1; index < this->workerCount; index++) {
+        threads.emplace_back(&ThreadPool::workerLoop, this, index);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::run(size_t taskCount, const std::function<void(size_t)> &task) {
+    if (threads.empty() || taskCount <= 1) {
+        for (size_t taskIndex = 0; taskIndex < taskCount; taskIndex++) {
+            task(taskIndex);
+        }
+        queues[0]->stats.tasksRun += taskCount;
+        return;
+    }
+
+    // Deal out contiguous blocks of task indices, one per worker
+    for (int index = 0; index < workerCount; index++) {
+        std::lock_guard<std::mutex> queueLock(queues[index]->mutex);
+        queues[index]->begin = taskCount * index / workerCount;
+        queues[index]->end = taskCount * (index + 1) / workerCount;
+    }
+    remainingTasks.store(taskCount, std::memory_order_release);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentTask = &task;
+        busyWorkers = (int) threads.size();
+        generation++;
+    }
+    wakeCondition.notify_all();
+
+    // The calling thread works alongside the other workers
+    workUntilDone(0, task);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this] { return busyWorkers == 0; });
+    currentTask = nullptr;
+}
+
+void ThreadPool::workerLoop(int index) {
+    currentWorkerIndex = index;
+    TraceRecorder::setThreadName("pool worker " + std::to_string(index));
+    long seenGeneration = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+        if (stopping) {
+            return;
+        }
+        seenGeneration = generation;
+        const std::function<void(size_t)> *task = currentTask;
+
+        lock.unlock();
+        workUntilDone(index, *task);
+        lock.lock();
+
+        if (--busyWorkers == 0) {
+            doneCondition.notify_one();
+        }
+    }
+}
+
+void ThreadPool::workUntilDone(int index, const std::function<void(size_t)> &task) {
+    TraceSpan workSpan("pool tasks");
+    WorkerStats &stats = queues[index]->stats;
+    bool isIdle = false;
+    std::chrono::steady_clock::time_point idleStart;
+
+    while (remainingTasks.load(std::memory_order_acquire) > 0) {
+        size_t taskIndex;
+        if (popOwnTask(index, taskIndex) || stealTask(index, taskIndex)) {
+            if (isIdle) {
+                stats.idleSeconds += secondsSince(idleStart);
+                isIdle = false;
+            }
+            task(taskIndex);
+            stats.tasksRun++;
+            remainingTasks.fetch_sub(1, std::memory_order_acq_rel);
+        } else {
+            // Nothing left to take, the remaining tasks are still running on other workers
+            if (!isIdle) {
+                idleStart = std::chrono::steady_clock::now();
+                isIdle = true;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    if (isIdle) {
+        stats.idleSeconds += secondsSince(idleStart);
+    }
+}
+
+bool ThreadPool::popOwnTask(int index, size_t &taskIndex) {
+    WorkerQueue &queue = *queues[index];
+    std::lock_guard<std::mutex> queueLock(queue.mutex);
+    if (queue.begin == queue.end) {
+        return false;
+    }
+    taskIndex = queue.begin++;
+    return true;
+}
+
+bool ThreadPool::stealTask(int index, size_t &taskIndex) {
+    for (int offset = 1; offset < workerCount; offset++) {
+        WorkerQueue &victim = *queues[(index + offset) % workerCount];
+        size_t stolenBegin, stolenEnd;
+        {
+            std::lock_guard<std::mutex> victimLock(victim.mutex);
+            if (victim.begin == victim.end) {
+                continue;
+            }
+            // Take the back half, rounding up so a single remaining task can be stolen as well
+            stolenEnd = victim.end;
+            stolenBegin = victim.end - (victim.end - victim.begin + 1) / 2;
+            victim.end = stolenBegin;
+        }
+
+        // Run the first stolen task right away and keep the rest in the worker's own queue
+        WorkerQueue &queue = *queues[index];
+        std::lock_guard<std::mutex> queueLock(queue.mutex);
+        queue.begin = stolenBegin + 1;
+        queue.end = stolenEnd;
+        queue.stats.steals++;
+        taskIndex = stolenBegin;
+        return true;
+    }
+
+    queues[index]->stats.failedSteals++;
+    return false;
+}
+
+std::vector<WorkerStats> ThreadPool::getWorkerStats() const {
+    std::vector<WorkerStats> workerStats;
+    for (const auto &queue: queues) {
+        std::lock_guard<std::mutex> queueLock(queue->mutex);
+        workerStats.push_back(queue->stats);
+    }
+    return workerStats;
+}
+
+void ThreadPool::resetWorkerStats() {
+    for (const auto &queue: queues) {
+        std::lock_guard<std::mutex> queueLock(queue->mutex);
+        queue->stats = WorkerStats();
+    }
+}
+
+void ThreadPool::printWorkerStats(std::ostream &outputStream) const {
+    outputStream << std::setw(8) << "worker" << std::setw(12) << "tasks" << std::setw(10) << "steals"
+                 << std::setw(14) << "failed steals" << std::setw(12) << "idle sec" << std::endl;
+    std::vector<WorkerStats> workerStats = getWorkerStats();
+    for (size_t index = 0; index < workerStats.size(); index++) {
+        outputStream << std::setw(8) << index << std::setw(12) << workerStats[index].tasksRun << std::setw(10)
+                     << workerStats[index].steals << std::setw(14) << workerStats[index].failedSteals
+                     << std::setw(12) << std::fixed << std::setprecision(3) << workerStats[index].idleSeconds
+                     << std::endl;
+    }
+}
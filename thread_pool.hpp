@@ -0,0 +1,116 @@
+#ifndef ECOSIM_THREAD_POOL_HPP
+#define ECOSIM_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+/**
+ * Load balancing counters of a single pool worker
+ */
+struct WorkerStats {
+    uint64_t tasksRun = 0;
+    uint64_t steals = 0;
+    uint64_t failedSteals = 0;
+    double idleSeconds = 0;
+};
+
+/**
+ * Work-stealing pool of worker threads used to run the tasks of a simulation phase. The calling thread takes part
+ * as worker 0, so a pool with a single worker runs everything inline.
+ *
+ * Each run hands every worker a contiguous block of task indices. Workers take tasks from the front of their own
+ * block and, once it is empty, steal the back half of another worker's block, so a worker that drew densely
+ * populated tiles sheds work to the ones that finished early
+ */
+class ThreadPool {
+public:
+    /**
+     * Starts the pool
+     * @param workerCount total number of workers including the calling thread
+     */
+    explicit ThreadPool(int workerCount);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * Runs the task once for every index in [0, taskCount) and blocks until all of them have finished
+     * @param taskCount number of task indices to run
+     * @param task callable taking the task index
+     */
+    void run(size_t taskCount, const std::function<void(size_t)> &task);
+
+    int getWorkerCount() const { return workerCount; }
+
+    /**
+     * Returns the load balancing counters of every worker, accumulated since the pool started or was last reset
+     * @return counters indexed by worker
+     */
+    std::vector<WorkerStats> getWorkerStats() const;
+
+    void resetWorkerStats();
+
+    /**
+     * Prints a table of the tasks run, steals and idle time of every worker
+     * @param outputStream stream to print the table to
+     */
+    void printWorkerStats(std::ostream &outputStream) const;
+
+    /**
+     * Returns the index of the pool worker running on the calling thread, 0 for any thread outside a pool
+     * @return worker index
+     */
+    static int workerIndex() { return currentWorkerIndex; }
+
+private:
+    /**
+     * Task indices still owned by one worker along with its counters. Padded to a cache line so workers polling
+     * their own queue do not contend with each other
+     */
+    struct alignas(64) WorkerQueue {
+        mutable std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+        WorkerStats stats;
+    };
+
+    void workerLoop(int index);
+
+    /**
+     * Runs tasks from the worker's own queue and steals from the others until every task of the run is done
+     * @param index worker index
+     * @param task callable taking the task index
+     */
+    void workUntilDone(int index, const std::function<void(size_t)> &task);
+
+    bool popOwnTask(int index, size_t &taskIndex);
+
+    bool stealTask(int index, size_t &taskIndex);
+
+    static thread_local int currentWorkerIndex;
+
+    int workerCount;
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::atomic<size_t> remainingTasks{0};
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    const std::function<void(size_t)> *currentTask = nullptr;
+    long generation = 0;
+    int busyWorkers = 0;
+    bool stopping = false;
+};
+
+#endif //ECOSIM_THREAD_POOL_HPP
@@ -0,0 +1,226 @@
+#include "tick_engine.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+#include "action_log.hpp"
+#include "map_manager.hpp"
+#include "plant.hpp"
+#include "herbivore.hpp"
+#include "omnivore.hpp"
+#include "population_recorder.hpp"
+#include "tick_stats.hpp"
+#include "trace_recorder.hpp"
+
+static_assert(TickEngine::TILE_SIZE >= 2 * TickEngine::INTERACTION_RADIUS,
+              "Tiles of the same colour must be further apart than two interaction radii");
+
+// Number of due events handed to a worker at a time in the plant phase
+static const size_t PLANT_CHUNK_SIZE = 1024;
+
+void TickEngine::runTick() {
+    World &world = World::current();
+    TraceSpan tickSpan("tick", world.tickCount);
+    TickStats::beginTick(world.tickCount);
+    runPlantPhase();
+    runAnimalPhase(SpeciesType::HERBIVORE);
+    runAnimalPhase(SpeciesType::OMNIVORE);
+    PopulationRecorder::recordTick(world.tickCount);
+    world.tickCount++;
+    ActionLog::endTick();
+}
+
+void TickEngine::runPlantPhase() {
+    PhaseTimer phaseTimer(PLANT_PHASE);
+    World &world = World::current();
+    std::vector<ScheduledEvent> &dueEvents = world.dueEvents;
+    world.events.takeDue(world.tickCount, dueEvents);
+
+    // Each event only writes its own element's slot, so the events can be split into chunks with no further
+    // coordination
+    size_t eventCount = dueEvents.size();
+    size_t chunkCount = (eventCount + PLANT_CHUNK_SIZE - 1) / PLANT_CHUNK_SIZE;
+    auto tickPlantChunk = [eventCount, &dueEvents](size_t chunk) {
+        size_t lastEvent = min(eventCount, (chunk + 1) * PLANT_CHUNK_SIZE);
+        for (size_t eventIndex = chunk * PLANT_CHUNK_SIZE; eventIndex < lastEvent; eventIndex++) {
+            const ScheduledEvent &event = dueEvents[eventIndex];
+            if (event.type == REGROWN_EVENT && MapManager::entities().isAlive(event.id)) {
+                Plant::regrow(event.id);
+            }
+        }
+    };
+
+    runTasks(chunkCount, tickPlantChunk);
+    MapManager::swapBuffers();
+}
+
+void TickEngine::runAnimalPhase(SpeciesType speciesType) {
+    PhaseTimer phaseTimer(speciesType == SpeciesType::HERBIVORE ? HERBIVORE_PHASE : OMNIVORE_PHASE);
+    bucketByTile(speciesType);
+
+    World &world = World::current();
+    auto tickTile = [speciesType, &world](size_t tileIndex) {
+        for (size_t member = world.tileStarts[tileIndex]; member < world.tileStarts[tileIndex + 1]; member++) {
+            tickAnimal(world.tileMembers[member], speciesType);
+        }
+    };
+
+    for (const std::vector<int> &tiles: world.colourTiles) {
+        runTasks(tiles.size(), [&](size_t taskIndex) { tickTile(tiles[taskIndex]); });
+        // Tiles of the next colour may act on cells this colour changed, so its entries have to come later
+        ActionLog::collectWorkerEntries();
+    }
+    MapManager::swapBuffers();
+}
+
+void TickEngine::tickAnimal(EntityId id, SpeciesType speciesType) {
+    // Skip animals that were eaten earlier in this phase
+    if (!MapManager::nextEntities().isAlive(id)) {
+        return;
+    }
+
+    // Check if energy levels are depleted
+    if (MapManager::entities().getEnergy(id) <= 0) {
+        MapManager::killElement(id);
+    } else {
+        // Draws depend only on the seed, tick and animal, never on which thread ticks the animal or when
+        CounterRng rng(getSeed(), (uint64_t) getTickCount(), (uint32_t) id);
+        if (speciesType == SpeciesType::HERBIVORE) {
+            Herbivore::tick(id, rng);
+        } else {
+            Omnivore::tick(id, rng);
+        }
+    }
+}
+
+void TickEngine::bucketByTile(SpeciesType speciesType) {
+    int tilesX = (MapManager::mapColumns() + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (MapManager::mapRows() + TILE_SIZE - 1) / TILE_SIZE;
+    size_t tileCount = (size_t) tilesX * tilesY;
+
+    // Only the member lists of the phase's species are visited
+    auto forEachMember = [speciesType](auto &&visitor) {
+        for (size_t speciesIndex = 0; speciesIndex < MapManager::species().size(); speciesIndex++) {
+            if (MapManager::species()[(SpeciesIndex) speciesIndex].speciesType == speciesType) {
+                for (EntityId id: MapManager::entities().membersOf((SpeciesIndex) speciesIndex)) {
+                    visitor(id);
+                }
+            }
+        }
+    };
+
+    // Counting sort of the animals by tile keeps them in member list order within each tile
+    World &world = World::current();
+    std::vector<size_t> &tileStarts = world.tileStarts;
+    std::vector<EntityId> &tileMembers = world.tileMembers;
+    tileStarts.assign(tileCount + 1, 0);
+    auto tileOf = [tilesX](const Point &location) {
+        return (size_t) (location.second / TILE_SIZE) * tilesX + location.first / TILE_SIZE;
+    };
+    forEachMember([&](EntityId id) {
+        tileStarts[tileOf(MapManager::entities().getLocation(id)) + 1]++;
+    });
+    for (size_t tile = 0; tile < tileCount; tile++) {
+        tileStarts[tile + 1] += tileStarts[tile];
+    }
+
+    tileMembers.resize(tileStarts[tileCount]);
+    std::vector<size_t> &nextSlot = world.tileNextSlot;
+    nextSlot.assign(tileStarts.begin(), tileStarts.end() - 1);
+    forEachMember([&](EntityId id) {
+        tileMembers[nextSlot[tileOf(MapManager::entities().getLocation(id))]++] = id;
+    });
+
+    for (std::vector<int> &tiles: world.colourTiles) {
+        tiles.clear();
+    }
+    for (int tileY = 0; tileY < tilesY; tileY++) {
+        for (int tileX = 0; tileX < tilesX; tileX++) {
+            int tile = tileY * tilesX + tileX;
+            if (tileStarts[tile] != tileStarts[tile + 1]) {
+                world.colourTiles[(tileX & 1) | ((tileY & 1) << 1)].push_back(tile);
+            }
+        }
+    }
+}
+
+void TickEngine::setThreadCount(int threadCount) {
+    threadCount = max(1, threadCount);
+    WorldPool &pool = World::current().pool;
+    if (threadCount != getThreadCount()) {
+        pool.reset();
+        if (threadCount > 1) {
+            pool = std::make_unique<ThreadPool>(threadCount);
+        }
+    }
+    MapManager::setWorkerCount(threadCount);
+    TickStats::setWorkerCount(threadCount);
+    PopulationRecorder::setWorkerCount(threadCount);
+    ActionLog::setWorkerCount(threadCount);
+}
+
+void TickEngine::printSchedulerStats(std::ostream &outputStream) {
+    const WorldPool &pool = World::current().pool;
+    if (!pool) {
+        outputStream << "Scheduler statistics are only collected when running on more than one thread" << std::endl;
+        return;
+    }
+    outputStream << "Scheduler statistics for " << pool->getWorkerCount() << " workers" << std::endl;
+    pool->printWorkerStats(outputStream);
+}
+
+void TickEngine::printScalingReport(int ticks, int maxThreads, std::ostream &outputStream) {
+    // Keep a copy of the loaded world so every measurement starts from the same state
+    World savedWorld = World::current();
+    int savedThreadCount = getThreadCount();
+
+    outputStream << "Scaling report: " << MapManager::mapRows() << "x" << MapManager::mapColumns() << " map, "
+                 << MapManager::entities().aliveCount() << " elements, " << ticks << " ticks per run" << std::endl;
+    outputStream << std::setw(8) << "threads" << std::setw(12) << "seconds" << std::setw(12) << "ticks/sec"
+                 << std::setw(10) << "speedup" << std::setw(12) << "efficiency" << std::setw(10) << "steals"
+                 << std::setw(8) << "idle" << std::endl;
+
+    // Powers of two up to the maximum, followed by the maximum itself
+    std::vector<int> threadCounts;
+    for (int threadCount = 1; threadCount < maxThreads; threadCount *= 2) {
+        threadCounts.push_back(threadCount);
+    }
+    threadCounts.push_back(max(1, maxThreads));
+
+    double baseTicksPerSecond = 0;
+    for (int threadCount: threadCounts) {
+        // Restoring the world also gives up its pool, so every measurement starts with fresh scheduler statistics
+        World::current() = savedWorld;
+        setThreadCount(threadCount);
+
+        auto startTime = std::chrono::steady_clock::now();
+        for (int tickNum = 0; tickNum < ticks; tickNum++) {
+            runTick();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+        double ticksPerSecond = ticks / max(elapsed.count(), 1e-9);
+        if (threadCount == 1) {
+            baseTicksPerSecond = ticksPerSecond;
+        }
+        double speedup = ticksPerSecond / baseTicksPerSecond;
+
+        // Share of the total worker time spent waiting for other workers to finish
+        uint64_t steals = 0;
+        double idleSeconds = 0;
+        for (const WorkerStats &workerStats: getSchedulerStats()) {
+            steals += workerStats.steals;
+            idleSeconds += workerStats.idleSeconds;
+        }
+
+        outputStream << std::setw(8) << threadCount << std::setw(12) << std::fixed << std::setprecision(3)
+                     << elapsed.count() << std::setw(12) << std::setprecision(1) << ticksPerSecond
+                     << std::setw(10) << std::setprecision(2) << speedup << std::setw(11) << std::setprecision(0)
+                     << 100 * speedup / threadCount << "%" << std::setw(10) << steals << std::setw(7)
+                     << 100 * idleSeconds / max(elapsed.count() * threadCount, 1e-9) << "%" << std::endl;
+    }
+
+    World::current() = savedWorld;
+    setThreadCount(savedThreadCount);
+}
@@ -0,0 +1,127 @@
+#ifndef ECOSIM_TICK_ENGINE_HPP
+#define ECOSIM_TICK_ENGINE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "species_type.hpp"
+#include "entity_store.hpp"
+#include "thread_pool.hpp"
+#include "event_scheduler.hpp"
+#include "world.hpp"
+
+/**
+ * Runs simulation ticks over the double-buffered world in MapManager. A tick is made of a plant phase followed by
+ * a herbivore phase and an omnivore phase. Each phase reads the committed state, writes its results into the
+ * pending buffers and commits them with MapManager::swapBuffers, so every element is updated exactly once per phase.
+ *
+ * Animal phases split the map into square tiles of TILE_SIZE cells. An animal only reads and writes cells within
+ * INTERACTION_RADIUS of itself, so tiles are coloured in a 2x2 pattern and all tiles of one colour run in parallel:
+ * two tiles of the same colour are always a whole tile apart, diagonal neighbours included. Animals in a tile are
+ * ticked in species member list order and the colours run one after another, so a run does not depend on the number of threads.
+ * Only occupied tiles become tasks, and the work-stealing pool balances them across threads
+ */
+class TickEngine {
+public:
+    /**
+     * Runs every phase of a single simulation tick
+     */
+    static void runTick();
+
+    /**
+     * Regrows the plants whose regrowth is due this tick. Only plants with a due event are visited
+     */
+    static void runPlantPhase();
+
+    /**
+     * Ticks every animal of the given species type, removing those that ran out of energy
+     * @param speciesType HERBIVORE or OMNIVORE
+     */
+    static void runAnimalPhase(SpeciesType speciesType);
+
+    /**
+     * Sets the number of threads used to run each phase
+     * @param threadCount number of threads including the calling thread
+     */
+    static void setThreadCount(int threadCount);
+
+    static int getThreadCount() {
+        const WorldPool &pool = World::current().pool;
+        return pool ? pool->getWorkerCount() : 1;
+    }
+
+    /**
+     * Returns the per-worker task, steal and idle counters of the thread pool
+     * @return counters indexed by worker, empty when running on a single thread
+     */
+    static std::vector<WorkerStats> getSchedulerStats() {
+        const WorldPool &pool = World::current().pool;
+        return pool ? pool->getWorkerStats() : std::vector<WorkerStats>();
+    }
+
+    /**
+     * Prints the per-worker task, steal and idle counters of the thread pool
+     * @param outputStream stream to print the counters to
+     */
+    static void printSchedulerStats(std::ostream &outputStream);
+
+    /**
+     * Measures tick throughput of the loaded world for 1, 2, 4... threads up to the given maximum and prints a
+     * table of ticks per second, speedup and parallel efficiency. Every measurement starts from the world as it was
+     * loaded, which is restored once the report is done
+     * @param ticks number of ticks to run per measurement
+     * @param maxThreads largest thread count to measure
+     * @param outputStream stream to print the report to
+     */
+    static void printScalingReport(int ticks, int maxThreads, std::ostream &outputStream);
+
+    static long getTickCount() { return World::current().tickCount; }
+
+    static void setTickCount(long tick) { World::current().tickCount = tick; }
+
+    /**
+     * Sets the seed every animal's random draws are derived from. Runs with the same seed and world are identical
+     * regardless of the thread count
+     * @param runSeed seed of the run
+     */
+    static void setSeed(uint64_t runSeed) { World::current().seed = runSeed; }
+
+    static uint64_t getSeed() { return World::current().seed; }
+
+    static const int INTERACTION_RADIUS = 1;
+    static const int TILE_SIZE = 32;
+
+private:
+    /**
+     * Buckets the animals of the given species type by tile and lists the occupied tiles of each colour
+     * @param speciesType species type to bucket
+     */
+    static void bucketByTile(SpeciesType speciesType);
+
+    static void tickAnimal(EntityId id, SpeciesType speciesType);
+
+    /**
+     * Runs a task for every index in [0, taskCount) on the current world's pool, switching every worker to the
+     * world, or on the calling thread if the world has no pool
+     * @param taskCount number of task indices to run
+     * @param task callable taking the task index
+     */
+    template<typename Task>
+    static void runTasks(size_t taskCount, const Task &task) {
+        World &world = World::current();
+        if (world.pool) {
+            world.pool->run(taskCount, [&world, &task](size_t taskIndex) {
+                WorldScope worldScope(world);
+                task(taskIndex);
+            });
+        } else {
+            for (size_t taskIndex = 0; taskIndex < taskCount; taskIndex++) {
+                task(taskIndex);
+            }
+        }
+    }
+};
+
+#endif //ECOSIM_TICK_ENGINE_HPP
@@ -0,0 +1,112 @@
+#include "tick_stats.hpp"
+
+#include <iomanip>
+
+#include "world.hpp"
+
+void TickStats::setRecording(bool enabled) {
+    World::current().tickStats.recording = enabled;
+}
+
+bool TickStats::isRecording() {
+    return World::current().tickStats.recording;
+}
+
+void TickStats::beginTick(long tick) {
+#ifndef INSTRUMENTATION_DISABLED
+    collectEvents();
+    TickStatsData &tickStats = World::current().tickStats;
+    if (tickStats.recording) {
+        tickStats.records.emplace_back();
+        tickStats.records.back().tick = tick;
+    }
+#endif
+}
+
+#ifndef INSTRUMENTATION_DISABLED
+
+void TickStats::countEvent(TickEvent event) {
+    World::current().tickStats.workerCounts[ThreadPool::workerIndex()].counts[event]++;
+}
+
+void TickStats::addPhaseTime(TickPhase phase, double seconds) {
+    std::vector<TickRecord> &records = World::current().tickStats.records;
+    if (!records.empty()) {
+        records.back().phaseSeconds[phase] += seconds;
+    }
+}
+
+#endif
+
+const char *TickStats::phaseName(TickPhase phase) {
+    static const char *PHASE_NAMES[PHASE_COUNT] = {"plant phase", "herbivore phase", "omnivore phase", "frame capture"};
+    return PHASE_NAMES[phase];
+}
+
+void TickStats::setWorkerCount(int workerCount) {
+    // Fold counts of workers that are about to go away into the current record first
+    collectEvents();
+    World::current().tickStats.workerCounts.resize(workerCount);
+}
+
+const std::vector<TickRecord> &TickStats::getRecords() {
+    collectEvents();
+    return World::current().tickStats.records;
+}
+
+void TickStats::clear() {
+    TickStatsData &tickStats = World::current().tickStats;
+    tickStats.records.clear();
+    for (TickStatsData::WorkerCounts &worker: tickStats.workerCounts) {
+        worker.counts.fill(0);
+    }
+}
+
+void TickStats::collectEvents() {
+    TickStatsData &tickStats = World::current().tickStats;
+    for (TickStatsData::WorkerCounts &worker: tickStats.workerCounts) {
+        if (!tickStats.records.empty()) {
+            for (int event = 0; event < EVENT_COUNT; event++) {
+                tickStats.records.back().eventCounts[event] += worker.counts[event];
+            }
+        }
+        worker.counts.fill(0);
+    }
+}
+
+void TickStats::printTable(std::ostream &outputStream) {
+#ifdef INSTRUMENTATION_DISABLED
+    outputStream << "Tick instrumentation was compiled out" << std::endl;
+#else
+    collectEvents();
+    outputStream << std::setw(8) << "tick" << std::setw(10) << "plant ms" << std::setw(10) << "herb ms"
+                 << std::setw(10) << "omni ms" << std::setw(10) << "draw ms" << std::setw(10) << "moves"
+                 << std::setw(10) << "eats" << std::setw(10) << "births" << std::setw(10) << "deaths"
+                 << std::setw(12) << "queries" << std::endl;
+
+    auto printRow = [&outputStream](const TickRecord &record) {
+        outputStream << std::fixed << std::setprecision(3);
+        for (double seconds: record.phaseSeconds) {
+            outputStream << std::setw(10) << seconds * 1000;
+        }
+        for (int event = 0; event < EVENT_COUNT; event++) {
+            outputStream << std::setw(event == NEIGHBOR_QUERY_EVENT ? 12 : 10) << record.eventCounts[event];
+        }
+        outputStream << std::endl;
+    };
+
+    TickRecord totals;
+    for (const TickRecord &record: World::current().tickStats.records) {
+        outputStream << std::setw(8) << record.tick;
+        printRow(record);
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            totals.phaseSeconds[phase] += record.phaseSeconds[phase];
+        }
+        for (int event = 0; event < EVENT_COUNT; event++) {
+            totals.eventCounts[event] += record.eventCounts[event];
+        }
+    }
+    outputStream << std::setw(8) << "total";
+    printRow(totals);
+#endif
+}
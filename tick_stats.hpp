@@ -0,0 +1,154 @@
+#ifndef ECOSIM_TICK_STATS_HPP
+#define ECOSIM_TICK_STATS_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "thread_pool.hpp"
+#include "trace_recorder.hpp"
+
+/**
+ * Timed parts of a tick
+ */
+enum TickPhase {
+    PLANT_PHASE, HERBIVORE_PHASE, OMNIVORE_PHASE, DRAW_PHASE, PHASE_COUNT
+};
+
+/**
+ * Events counted through MapManager. An eater steps onto its food, so every eat is also counted as a move, and an
+ * eaten animal is also counted as a death
+ */
+enum TickEvent {
+    MOVE_EVENT, EAT_EVENT, BIRTH_EVENT, DEATH_EVENT, NEIGHBOR_QUERY_EVENT, EVENT_COUNT
+};
+
+/**
+ * Wall time of every phase and number of every event during one tick
+ */
+struct TickRecord {
+    long tick = 0;
+    std::array<double, PHASE_COUNT> phaseSeconds{};
+    std::array<uint64_t, EVENT_COUNT> eventCounts{};
+};
+
+/**
+ * Records and pending event counts of one world
+ */
+struct TickStatsData {
+    struct alignas(64) WorkerCounts {
+        std::array<uint64_t, EVENT_COUNT> counts{};
+    };
+
+    std::vector<TickRecord> records;
+    std::vector<WorkerCounts> workerCounts = std::vector<WorkerCounts>(1);
+    // Records are only kept while set, so long runs that never print them do not grow
+    bool recording = false;
+};
+
+/**
+ * Per-tick instrumentation of the main loop, kept separately for every world. Events are counted per pool worker,
+ * so counting never contends between threads, and folded into the current tick's record when the next tick begins
+ * or the records are read. A world only keeps records once recording was switched on for it.
+ *
+ * Defining INSTRUMENTATION_DISABLED compiles every counter and timer down to nothing
+ */
+class TickStats {
+public:
+    /**
+     * Switches keeping a record of every tick on or off for the current world. Records kept so far are left alone
+     * @param enabled whether ticks starting from now on are recorded
+     */
+    static void setRecording(bool enabled);
+
+    static bool isRecording();
+
+    /**
+     * Closes the record of the previous tick and opens one for the given tick while recording
+     * @param tick number of the tick that is starting
+     */
+    static void beginTick(long tick);
+
+#ifndef INSTRUMENTATION_DISABLED
+
+    static void countEvent(TickEvent event);
+
+    static void addPhaseTime(TickPhase phase, double seconds);
+
+#else
+
+    static void countEvent(TickEvent) {}
+
+    static void addPhaseTime(TickPhase, double) {}
+
+#endif
+
+    /**
+     * Returns the name a phase is shown with in traces
+     * @param phase timed phase
+     * @return name of the phase
+     */
+    static const char *phaseName(TickPhase phase);
+
+    /**
+     * Sets the number of pool workers that may count events concurrently
+     * @param workerCount number of workers
+     */
+    static void setWorkerCount(int workerCount);
+
+    /**
+     * Returns the record of every tick since the last clear, including the tick in progress
+     * @return records in tick order, empty when instrumentation is compiled out
+     */
+    static const std::vector<TickRecord> &getRecords();
+
+    /**
+     * Discards every record and pending count
+     */
+    static void clear();
+
+    /**
+     * Prints one row per tick with the time of every phase and the count of every event, followed by the totals
+     * @param outputStream stream to print the table to
+     */
+    static void printTable(std::ostream &outputStream);
+
+private:
+    /**
+     * Adds the pending counts of every worker to the current record
+     */
+    static void collectEvents();
+};
+
+/**
+ * Adds the time between its construction and destruction to a phase of the current tick and, while a trace is
+ * recorded, records it as a span
+ */
+class PhaseTimer {
+public:
+#ifndef INSTRUMENTATION_DISABLED
+
+    explicit PhaseTimer(TickPhase phase) : phase(phase), startTime(std::chrono::steady_clock::now()) {}
+
+    ~PhaseTimer() {
+        std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = endTime - startTime;
+        TickStats::addPhaseTime(phase, elapsed.count());
+        if (TraceRecorder::isRecording()) {
+            TraceRecorder::recordSpan(TickStats::phaseName(phase), startTime, endTime, TraceRecorder::NO_ARGUMENT);
+        }
+    }
+
+private:
+    TickPhase phase;
+    std::chrono::steady_clock::time_point startTime;
+#else
+
+    explicit PhaseTimer(TickPhase) {}
+
+#endif
+};
+
+#endif //ECOSIM_TICK_STATS_HPP
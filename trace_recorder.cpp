@@ -0,0 +1,114 @@
+#include "trace_recorder.hpp"
+
+#include <iomanip>
+
+/**
+ * Ring buffer of one track
+ */
+struct TraceRecorder::ThreadTrace {
+    struct Span {
+        const char *name;
+        int64_t startNanos;
+        int64_t durationNanos;
+        int64_t argument;
+    };
+
+    std::string threadName;
+    int trackId = 0;
+    std::vector<Span> spans;
+    size_t nextSpan = 0;
+    bool wrapped = false;
+};
+
+std::atomic<bool> TraceRecorder::recording(false);
+std::chrono::steady_clock::time_point TraceRecorder::startTime;
+std::mutex TraceRecorder::trackMutex;
+std::vector<std::unique_ptr<TraceRecorder::ThreadTrace>> TraceRecorder::tracks;
+thread_local TraceRecorder::ThreadTrace *TraceRecorder::currentTrack = nullptr;
+
+void TraceRecorder::start() {
+    startTime = std::chrono::steady_clock::now();
+    recording = true;
+}
+
+void TraceRecorder::setThreadName(const std::string &threadName) {
+    std::lock_guard<std::mutex> lock(trackMutex);
+    for (auto &track: tracks) {
+        if (track->threadName == threadName) {
+            currentTrack = track.get();
+            return;
+        }
+    }
+    tracks.push_back(std::make_unique<ThreadTrace>());
+    tracks.back()->threadName = threadName;
+    tracks.back()->trackId = (int) tracks.size();
+    currentTrack = tracks.back().get();
+}
+
+TraceRecorder::ThreadTrace &TraceRecorder::threadTrace() {
+    if (currentTrack == nullptr) {
+        std::lock_guard<std::mutex> lock(trackMutex);
+        tracks.push_back(std::make_unique<ThreadTrace>());
+        tracks.back()->threadName = "thread " + std::to_string(tracks.size());
+        tracks.back()->trackId = (int) tracks.size();
+        currentTrack = tracks.back().get();
+    }
+    return *currentTrack;
+}
+
+void TraceRecorder::recordSpan(const char *name, std::chrono::steady_clock::time_point spanStart,
+                               std::chrono::steady_clock::time_point spanEnd, int64_t argument) {
+    ThreadTrace &trace = threadTrace();
+    if (trace.spans.empty()) {
+        trace.spans.resize(SPANS_PER_THREAD);
+    }
+    trace.spans[trace.nextSpan] = {
+            name, std::chrono::duration_cast<std::chrono::nanoseconds>(spanStart - startTime).count(),
+            std::chrono::duration_cast<std::chrono::nanoseconds>(spanEnd - spanStart).count(), argument};
+    if (++trace.nextSpan == SPANS_PER_THREAD) {
+        trace.nextSpan = 0;
+        trace.wrapped = true;
+    }
+}
+
+void TraceRecorder::writeJson(std::ostream &outputStream) {
+    std::lock_guard<std::mutex> lock(trackMutex);
+    outputStream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool isFirstEvent = true;
+    auto startEvent = [&]() {
+        outputStream << (isFirstEvent ? "\n" : ",\n");
+        isFirstEvent = false;
+    };
+
+    outputStream << std::fixed << std::setprecision(3);
+    for (const auto &track: tracks) {
+        startEvent();
+        outputStream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track->trackId
+                     << ",\"args\":{\"name\":\"" << track->threadName << "\"}}";
+
+        // A wrapped buffer continues with its oldest span right after the newest one
+        size_t spanCount = track->wrapped ? SPANS_PER_THREAD : track->nextSpan;
+        size_t firstSpan = track->wrapped ? track->nextSpan : 0;
+        for (size_t offset = 0; offset < spanCount; offset++) {
+            const ThreadTrace::Span &span = track->spans[(firstSpan + offset) % SPANS_PER_THREAD];
+            startEvent();
+            outputStream << "{\"name\":\"" << span.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << track->trackId
+                         << ",\"ts\":" << (double) span.startNanos / 1000 << ",\"dur\":"
+                         << (double) span.durationNanos / 1000;
+            if (span.argument != NO_ARGUMENT) {
+                outputStream << ",\"args\":{\"value\":" << span.argument << "}";
+            }
+            outputStream << "}";
+        }
+    }
+    outputStream << "\n]}" << std::endl;
+}
+
+void TraceRecorder::clear() {
+    std::lock_guard<std::mutex> lock(trackMutex);
+    recording = false;
+    for (auto &track: tracks) {
+        track->nextSpan = 0;
+        track->wrapped = false;
+    }
+}
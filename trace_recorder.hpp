@@ -0,0 +1,110 @@
+#ifndef ECOSIM_TRACE_RECORDER_HPP
+#define ECOSIM_TRACE_RECORDER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Records timed spans in the Chrome trace-event format, viewable in chrome://tracing or Perfetto. Every thread
+ * writes to its own fixed-size ring buffer without locking, so recording a span costs two clock reads and a store.
+ * When a buffer is full the oldest spans of that thread are overwritten. The buffers are only read when the trace
+ * is written, which has to happen while no other thread is recording.
+ *
+ * Every thread appears on its own track, named with setThreadName. Recording is off until start is called, and
+ * defining INSTRUMENTATION_DISABLED compiles every span down to nothing
+ */
+class TraceRecorder {
+public:
+    /**
+     * Starts recording. Span times are measured from this call
+     */
+    static void start();
+
+    static bool isRecording() { return recording.load(std::memory_order_relaxed); }
+
+    /**
+     * Names the calling thread's track. Threads given the same name share a track, so only one of them may be
+     * running at any time
+     * @param threadName name shown for the track
+     */
+    static void setThreadName(const std::string &threadName);
+
+    /**
+     * Records a span on the calling thread's track
+     * @param name name of the span, which has to outlive the recorder, such as a string literal
+     * @param startTime start of the span
+     * @param endTime end of the span
+     * @param argument value shown with the span, such as a tick number, or NO_ARGUMENT
+     */
+    static void recordSpan(const char *name, std::chrono::steady_clock::time_point startTime,
+                           std::chrono::steady_clock::time_point endTime, int64_t argument);
+
+    /**
+     * Writes every recorded span as a trace-event JSON document
+     * @param outputStream stream to write the trace to
+     */
+    static void writeJson(std::ostream &outputStream);
+
+    /**
+     * Stops recording and discards every span. Tracks keep their names
+     */
+    static void clear();
+
+    static const int64_t NO_ARGUMENT = INT64_MIN;
+    static const size_t SPANS_PER_THREAD = 1 << 16;
+
+private:
+    struct ThreadTrace;
+
+    /**
+     * Returns the calling thread's trace, registering it on first use
+     */
+    static ThreadTrace &threadTrace();
+
+    static std::atomic<bool> recording;
+    static std::chrono::steady_clock::time_point startTime;
+    // Tracks are only added under the mutex, after that each one is written by its own thread alone
+    static std::mutex trackMutex;
+    static std::vector<std::unique_ptr<ThreadTrace>> tracks;
+    static thread_local ThreadTrace *currentTrack;
+};
+
+/**
+ * Records the time between its construction and destruction as a span on the calling thread's track
+ */
+class TraceSpan {
+public:
+#ifndef INSTRUMENTATION_DISABLED
+
+    explicit TraceSpan(const char *name, int64_t argument = TraceRecorder::NO_ARGUMENT) : name(name),
+                                                                                          argument(argument) {
+        if (TraceRecorder::isRecording()) {
+            startTime = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~TraceSpan() {
+        if (TraceRecorder::isRecording()) {
+            TraceRecorder::recordSpan(name, startTime, std::chrono::steady_clock::now(), argument);
+        }
+    }
+
+private:
+    const char *name;
+    int64_t argument;
+    std::chrono::steady_clock::time_point startTime;
+#else
+
+    explicit TraceSpan(const char *, int64_t = 0) {}
+
+#endif
+};
+
+#endif //ECOSIM_TRACE_RECORDER_HPP
@@ -0,0 +1,62 @@
+#ifndef ECOSIM_TRIPLE_BUFFER_HPP
+#define ECOSIM_TRIPLE_BUFFER_HPP
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lock-free single producer, single consumer triple buffer. The producer fills the back buffer and publishes it, the
+ * consumer picks up the newest published buffer whenever it is ready for one. Neither side ever waits for the other:
+ * buffers published while the consumer is busy simply replace each other, so the consumer only sees the latest one.
+ *
+ * The middle slot is handed back and forth with a single atomic exchange that carries the index of the slot and a
+ * flag telling the consumer whether it holds a buffer it has not seen yet
+ */
+template<typename T>
+class TripleBuffer {
+public:
+    /**
+     * Returns the buffer the producer writes to. Only the producer may call this
+     * @return back buffer
+     */
+    T &backBuffer() { return slots[backIndex]; }
+
+    /**
+     * Makes the back buffer the newest buffer for the consumer and hands the producer a free one. The new back
+     * buffer holds stale contents that have to be overwritten
+     */
+    void publish() {
+        backIndex = (uint8_t) (middleSlot.exchange((uint8_t) (backIndex | FRESH_FLAG), std::memory_order_acq_rel) &
+                               INDEX_MASK);
+    }
+
+    /**
+     * Takes the newest published buffer if there is one the consumer has not seen yet. Only the consumer may call this
+     * @return true if frontBuffer changed
+     */
+    bool consume() {
+        if ((middleSlot.load(std::memory_order_relaxed) & FRESH_FLAG) == 0) {
+            return false;
+        }
+        frontIndex = (uint8_t) (middleSlot.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK);
+        return true;
+    }
+
+    /**
+     * Returns the buffer the consumer last took. Only the consumer may call this
+     * @return front buffer
+     */
+    const T &frontBuffer() const { return slots[frontIndex]; }
+
+private:
+    static const uint8_t INDEX_MASK = 3;
+    static const uint8_t FRESH_FLAG = 4;
+
+    T slots[3];
+    // Each side's index sits on its own cache line so producer and consumer do not share one
+    alignas(64) uint8_t backIndex = 0;
+    alignas(64) uint8_t frontIndex = 1;
+    alignas(64) std::atomic<uint8_t> middleSlot{2};
+};
+
+#endif //ECOSIM_TRIPLE_BUFFER_HPP
@@ -0,0 +1,3 @@
+#include "world.hpp"
+
+World World::defaultWorld;
@@ -0,0 +1,116 @@
+#ifndef ECOSIM_WORLD_HPP
+#define ECOSIM_WORLD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "entity_store.hpp"
+#include "species_table.hpp"
+#include "flora_fauna_grid.hpp"
+#include "terrain_raster.hpp"
+#include "event_scheduler.hpp"
+#include "action_log.hpp"
+#include "population_recorder.hpp"
+#include "thread_pool.hpp"
+#include "tick_stats.hpp"
+
+/**
+ * Thread pool of a world. A pool only ever runs the phases of the world that created it, so a copy of a world starts
+ * without one and a world that is assigned to gives its own up
+ */
+class WorldPool : public std::unique_ptr<ThreadPool> {
+public:
+    WorldPool() = default;
+
+    WorldPool(const WorldPool &) : std::unique_ptr<ThreadPool>() {}
+
+    WorldPool(WorldPool &&) = default;
+
+    WorldPool &operator=(const WorldPool &) {
+        reset();
+        return *this;
+    }
+
+    WorldPool &operator=(WorldPool &&) = default;
+
+    using std::unique_ptr<ThreadPool>::operator=;
+};
+
+/**
+ * Complete state of one simulation: the double-buffered map and elements, species, scheduled events, tick count and
+ * seed, along with the thread pool, scratch buffers and instrumentation of the tick engine. Worlds are independent
+ * of each other and copying one gives a simulation that continues exactly like the original would.
+ *
+ * MapManager, TickEngine and TickStats act on the current world of the calling thread. Every thread starts out on
+ * the default world, so a process that only ever runs one simulation never has to name a world, and WorldScope
+ * switches a thread to another world. Pool workers are switched to the world whose phase they run
+ */
+class World {
+public:
+    /**
+     * Returns the world the calling thread acts on
+     * @return current world
+     */
+    static World &current() { return *currentWorld; }
+
+    FloraFaunaGrid floraFauna;
+    FloraFaunaGrid nextFloraFauna;
+    TerrainRaster terrain;
+    EntityStore entities;
+    EntityStore nextEntities;
+    SpeciesTable species;
+    EventScheduler events;
+    std::vector<std::vector<std::pair<Point, SpeciesIndex>>> pendingBirths = {{}};
+    int mapRows = 0;
+    int mapColumns = 0;
+    // While set, every commit appends the cells it may have changed to changedCells
+    bool trackChangedCells = false;
+    // Row-major indices of cells changed since a view last consumed them, possibly with repeats
+    std::vector<size_t> changedCells;
+
+    long tickCount = 0;
+    uint64_t seed = 0;
+    WorldPool pool;
+    // Scratch buffers of the tick engine, kept between ticks so they are allocated once
+    std::vector<ScheduledEvent> dueEvents;
+    std::vector<EntityId> tileMembers;
+    std::vector<size_t> tileStarts;
+    std::vector<size_t> tileNextSlot;
+    std::vector<int> colourTiles[4];
+
+    TickStatsData tickStats;
+    PopulationCountsData populationCounts;
+    ActionLogData actionLog;
+
+private:
+    friend class WorldScope;
+
+    static World defaultWorld;
+    static thread_local World *currentWorld;
+};
+
+// Defined here rather than in world.cpp so every translation unit sees that the pointer needs no dynamic
+// initialization and reads it directly instead of through a TLS wrapper call
+inline thread_local World *World::currentWorld = &World::defaultWorld;
+
+/**
+ * Switches the calling thread to a world for as long as the scope lives
+ */
+class WorldScope {
+public:
+    explicit WorldScope(World &world) : previousWorld(World::currentWorld) { World::currentWorld = &world; }
+
+    ~WorldScope() { World::currentWorld = previousWorld; }
+
+    WorldScope(const WorldScope &) = delete;
+
+    WorldScope &operator=(const WorldScope &) = delete;
+
+private:
+    World *previousWorld;
+};
+
+#endif //ECOSIM_WORLD_HPP